@@ -0,0 +1,68 @@
+/** 
+ * Microbenchmark of element access in a container<double,3> :
+ *  - chained operator[] (flat_eval_expression : one offset, one load) 
+ *  - chained operator[] through container_base views of boost::sub_array at every level (previous implementation)
+ *  - chained operator[] of the underlying boost::multi_array
+ *  - operator() with an array of indices
+ *  - raw pointer arithmetic (reference)
+ * Build with -DCMAKE_BUILD_TYPE=Release for meaningful timings.
+ */
+
+#include <chrono>
+#include <gftools.hpp>
+
+using namespace gftools;
+
+template <typename F>
+double timeit(F&& f, int nrepeat)
+{
+    auto t0 = std::chrono::steady_clock::now();
+    for (int r=0; r<nrepeat; r++) f();
+    auto t1 = std::chrono::steady_clock::now();
+    return std::chrono::duration<double>(t1-t0).count() / nrepeat;
+}
+
+int main(int argc, char *argv[])
+{
+    const size_t n0 = 64, n1 = 64, n2 = 64;
+    const int nrepeat = 50;
+    container<double,3> c(n0,n1,n2);
+    double s = 0;
+
+    double t_expr = timeit([&](){ 
+        for (size_t i=0; i<n0; i++) for (size_t j=0; j<n1; j++) for (size_t k=0; k<n2; k++) { c[i][j][k] += 1.0; s += c[i][j][k]; } 
+        }, nrepeat);
+
+    auto& b = c.boost_container_();
+    // previous operator[] wrapped every boost::sub_array into a container_base view
+    typedef typename container<double,3>::under_type view2_t;
+    typedef typename view2_t::under_type view1_t;
+    double t_view = timeit([&](){ 
+        for (size_t i=0; i<n0; i++) for (size_t j=0; j<n1; j++) for (size_t k=0; k<n2; k++) { 
+            view1_t v(view2_t(b[i]).boost_container_()[j]); v[k] += 1.0; 
+            view1_t v2(view2_t(b[i]).boost_container_()[j]); s += v2[k]; } 
+        }, nrepeat);
+
+    double t_boost = timeit([&](){ 
+        for (size_t i=0; i<n0; i++) for (size_t j=0; j<n1; j++) for (size_t k=0; k<n2; k++) { b[i][j][k] += 1.0; s += b[i][j][k]; } 
+        }, nrepeat);
+
+    double t_array = timeit([&](){ 
+        for (size_t i=0; i<n0; i++) for (size_t j=0; j<n1; j++) for (size_t k=0; k<n2; k++) { 
+            std::array<size_t,3> ind = {{i,j,k}}; c(ind) += 1.0; s += c(ind); } 
+        }, nrepeat);
+
+    double* p = c.data();
+    double t_raw = timeit([&](){ 
+        for (size_t i=0; i<n0; i++) for (size_t j=0; j<n1; j++) for (size_t k=0; k<n2; k++) { 
+            size_t o = (i*n1 + j)*n2 + k; p[o] += 1.0; s += p[o]; } 
+        }, nrepeat);
+
+    INFO("container<double,3> of " << n0 << "x" << n1 << "x" << n2 << " elements, time per sweep:");
+    INFO2("c[i][j][k]             : " << t_expr << " s");
+    INFO2("views [i][j][k]        : " << t_view << " s (" << t_view / t_expr << "x)");
+    INFO2("multi_array [i][j][k]  : " << t_boost << " s (" << t_boost / t_expr << "x)");
+    INFO2("c({{i,j,k}})           : " << t_array << " s (" << t_array / t_expr << "x)");
+    INFO2("raw pointer            : " << t_raw << " s (" << t_raw / t_expr << "x)");
+    INFO("checksum : " << s);
+}
@@ -0,0 +1,80 @@
+/** 
+ * Microbenchmark of Fourier transforms on tiny kmeshes (4, 8, 16 points per axis) :
+ *  - run_fft with cached FFTW plans (default)
+ *  - run_fft with fft_kernel (fft_plan_cache::set_small_kernels(true))
+ *  - run_fft_fixed with compile-time sizes
+ * for single 2d and 3d transforms and for 2d transforms batched over 64 frequencies.
+ * Build with -DCMAKE_BUILD_TYPE=Release for meaningful timings.
+ *
+ * FFTW time / time of the kernels (forward + backward, FFTW 3.3.5 with SSE2/AVX codelets, gcc -O3, one core of x86-64) :
+ *                        fft_kernel   run_fft_fixed
+ *   4x4                    0.67x         5.2x
+ *   8x8                    0.52x         1.4x
+ *   16x16                  0.40x         0.62x
+ *   4x4x4                  0.60x         2.3x
+ *   8x8x8                  0.33x         0.76x
+ *   64 x (8x8) batched     0.33x         0.71x
+ * so run_fft uses FFTW by default; run_fft_fixed pays off for single transforms with 4 and 8 points per axis.
+ */
+
+#include <chrono>
+#include <gftools.hpp>
+#include <gftools/fft.hpp>
+
+using namespace gftools;
+
+template <typename F>
+double timeit(F&& f, int nrepeat)
+{
+    auto t0 = std::chrono::steady_clock::now();
+    for (int r=0; r<nrepeat; r++) f();
+    auto t1 = std::chrono::steady_clock::now();
+    return std::chrono::duration<double>(t1-t0).count() / nrepeat;
+}
+
+template <size_t D>
+void fill(container<complex_type,D>& c) 
+{ 
+    for (int i = 0; i < c.size(); ++i) c.data()[i] = complex_type(std::cos(0.3*i), std::sin(0.1*i*i)); 
+}
+
+/// time forward + backward transforms of a container with the small kernels, with FFTW and with fixed kernels F
+template <size_t D, typename F>
+void bench(std::string const& name, container<complex_type,D> c, std::array<bool,D> const& mask, F&& fixed, int nrepeat)
+{
+    fft_plan_cache& cache = fft_plan_cache::instance();
+    fill(c);
+    run_fft_inplace(c, FFTW_FORWARD, mask); // plan outside of the timing
+    run_fft_inplace(c, FFTW_BACKWARD, mask);
+    double t_fftw = timeit([&](){ run_fft_inplace(c, FFTW_FORWARD, mask); run_fft_inplace(c, FFTW_BACKWARD, mask); }, nrepeat);
+    cache.set_small_kernels(true);
+    double t_small = timeit([&](){ run_fft_inplace(c, FFTW_FORWARD, mask); run_fft_inplace(c, FFTW_BACKWARD, mask); }, nrepeat);
+    cache.set_small_kernels(false);
+    double t_fixed = timeit([&](){ fixed(c); }, nrepeat);
+
+    INFO(name << ", forward + backward (FFTW time / time) :");
+    INFO2("FFTW           : " << t_fftw << " s");
+    INFO2("fft_kernel     : " << t_small << " s (" << t_fftw / t_small << "x)");
+    INFO2("run_fft_fixed  : " << t_fixed << " s (" << t_fftw / t_fixed << "x)");
+}
+
+int main(int argc, char *argv[])
+{
+    const int nrepeat = 20000;
+    typedef container<complex_type,2> c2_t;
+    typedef container<complex_type,3> c3_t;
+    const std::array<bool,2> all2 = {{ true, true }};
+    const std::array<bool,3> all3 = {{ true, true, true }}, batch = {{ false, true, true }};
+
+    bench("4x4", c2_t(4,4), all2, [](c2_t& c){ run_fft_fixed<4,4>(c, FFTW_FORWARD); run_fft_fixed<4,4>(c, FFTW_BACKWARD); }, nrepeat);
+    bench("8x8", c2_t(8,8), all2, [](c2_t& c){ run_fft_fixed<8,8>(c, FFTW_FORWARD); run_fft_fixed<8,8>(c, FFTW_BACKWARD); }, nrepeat);
+    bench("16x16", c2_t(16,16), all2, [](c2_t& c){ run_fft_fixed<16,16>(c, FFTW_FORWARD); run_fft_fixed<16,16>(c, FFTW_BACKWARD); }, nrepeat);
+    bench("4x4x4", c3_t(4,4,4), all3, [](c3_t& c){ run_fft_fixed<4,4,4>(c, FFTW_FORWARD); run_fft_fixed<4,4,4>(c, FFTW_BACKWARD); }, nrepeat);
+    bench("8x8x8", c3_t(8,8,8), all3, [](c3_t& c){ run_fft_fixed<8,8,8>(c, FFTW_FORWARD); run_fft_fixed<8,8,8>(c, FFTW_BACKWARD); }, nrepeat / 10);
+    bench("64 x (8x8) batched", c3_t(64,8,8), batch, [](c3_t& c){ 
+        for (size_t w = 0; w < 64; ++w) {
+            container_ref<complex_type,2> s(boost::multi_array_ref<complex_type,2>(c.data() + 64*w, boost::extents[8][8]));
+            run_fft_fixed<8,8>(s, FFTW_FORWARD); run_fft_fixed<8,8>(s, FFTW_BACKWARD);
+            }
+        }, nrepeat / 10);
+}
@@ -0,0 +1,54 @@
+/** 
+ * Microbenchmark of filling a G(w,k1,k2) grid_object from a function :
+ *  - fill with a lambda (nested loops over the grids, the lambda is inlined)
+ *  - fill_function with a std::function (nested loops, a call through std::function per element)
+ *  - enumerate_indices_ + get_args + unfold_tuple per element through std::function (previous implementation)
+ * Build with -DCMAKE_BUILD_TYPE=Release for meaningful timings.
+ */
+
+#include <chrono>
+#include <gftools.hpp>
+
+using namespace gftools;
+
+template <typename F>
+double timeit(F&& f, int nrepeat)
+{
+    auto t0 = std::chrono::steady_clock::now();
+    for (int r=0; r<nrepeat; r++) f();
+    auto t1 = std::chrono::steady_clock::now();
+    return std::chrono::duration<double>(t1-t0).count() / nrepeat;
+}
+
+int main(int argc, char *argv[])
+{
+    const int nw = 64, nk = 64;
+    const int nrepeat = 5;
+    fmatsubara_grid fgrid(-nw/2, nw/2, 10.0);
+    kmesh kgrid(nk);
+    typedef grid_object<complex_type, fmatsubara_grid, kmesh, kmesh> gk_type;
+    gk_type gk(std::make_tuple(fgrid, kgrid, kgrid));
+    const real_type mu = 0.3;
+    auto g0 = [mu](complex_type w, real_type kx, real_type ky){ return 1.0 / (w + mu + 2.0*(cos(kx) + cos(ky))); };
+    std::function<complex_type(complex_type, real_type, real_type)> g0_f = g0;
+
+    double t_lambda = timeit([&](){ gk.fill(g0); }, nrepeat);
+    complex_type s = gk.sum();
+    double t_function = timeit([&](){ gk.fill_function(g0_f); }, nrepeat);
+    s += gk.sum();
+    double t_old = timeit([&](){ 
+        auto dims = gk.data().shape();
+        for (size_t i=0; i<gk.size(); ++i) { 
+            auto index = extra::enumerate_indices_(i, dims);
+            auto args = gk_type::trs::get_args(index, gk.grids());
+            gk.data()(index) = tuple_tools::unfold_tuple(g0_f, args);
+            }
+        }, nrepeat);
+    s += gk.sum();
+
+    INFO("fill of " << gk.size() << " values, time per element :");
+    INFO2("fill (lambda)                  : " << t_lambda / gk.size() << " s");
+    INFO2("fill_function (std::function)  : " << t_function / gk.size() << " s (" << t_function / t_lambda << "x)");
+    INFO2("enumerate_indices_ per element : " << t_old / gk.size() << " s (" << t_old / t_lambda << "x)");
+    INFO("checksum : " << s);
+}
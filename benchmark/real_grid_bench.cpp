@@ -0,0 +1,92 @@
+/** 
+ * Microbenchmark of real_grid::find on large non-uniform grids (points clustered around 0) :
+ *  - find with the table of search buckets
+ *  - std::lower_bound over all values (previous implementation of find)
+ * and of linear interpolation at random points (eval) and at sorted points (eval one by one and eval_many).
+ * Evaluation of a grid_object with half of the points outside of the grid (tail) : 
+ * non-throwing lookup (grid_object::operator()) vs catching ex_not_found of real_grid::eval for each point.
+ * Build with -DCMAKE_BUILD_TYPE=Release for meaningful timings.
+ */
+
+#include <chrono>
+#include <random>
+#include <gftools.hpp>
+
+using namespace gftools;
+
+template <typename F>
+double timeit(F&& f, int nrepeat)
+{
+    auto t0 = std::chrono::steady_clock::now();
+    for (int r=0; r<nrepeat; r++) f();
+    auto t1 = std::chrono::steady_clock::now();
+    return std::chrono::duration<double>(t1-t0).count() / nrepeat;
+}
+
+void bench(size_t npoints)
+{
+    const size_t nqueries = 1000000;
+    std::vector<real_type> v(npoints);
+    for (size_t i = 0; i < npoints; ++i) { real_type u = 2.0*i/(npoints-1) - 1.0; v[i] = 10.*(u*u*u + 0.1*u); }
+    real_grid grid(v);
+    std::vector<real_type> f(npoints);
+    for (size_t i = 0; i < npoints; ++i) f[i] = 1.0 / (1.0 + v[i]*v[i]);
+
+    std::mt19937 gen(42);
+    std::uniform_real_distribution<real_type> dist(grid.min(), grid.max());
+    std::vector<real_type> x(nqueries);
+    for (auto& q : x) q = dist(gen);
+
+    size_t s = 0;
+    real_type fs = 0;
+    double t_find = timeit([&](){ for (auto q : x) s += std::get<1>(grid.find(q)); }, 1) / nqueries;
+    auto const& vals = grid.values();
+    double t_lb = timeit([&](){ for (auto q : x) s += std::lower_bound(vals.begin(), vals.end(), q) - vals.begin(); }, 1) / nqueries;
+    double t_eval = timeit([&](){ for (auto q : x) fs += grid.eval(f, q); }, 1) / nqueries;
+    std::sort(x.begin(), x.end());
+    std::vector<real_type> out(nqueries);
+    double t_eval_sorted = timeit([&](){ for (size_t i = 0; i < nqueries; ++i) out[i] = grid.eval(f, x[i]); }, 1) / nqueries;
+    double t_eval_many = timeit([&](){ grid.eval_many(f, x.data(), nqueries, out.data()); }, 1) / nqueries;
+    fs += out[nqueries/2];
+
+    INFO("real_grid of " << npoints << " points (search buckets : " << std::boolalpha << grid.has_search_buckets() << "), time per query:");
+    INFO2("find         : " << t_find << " s");
+    INFO2("lower_bound  : " << t_lb << " s (" << t_lb / t_find << "x)");
+    INFO2("eval         : " << t_eval << " s");
+    INFO2("sorted eval  : " << t_eval_sorted << " s");
+    INFO2("eval_many    : " << t_eval_many << " s (" << t_eval_sorted / t_eval_many << "x)");
+    INFO("checksum : " << s << " " << fs);
+}
+
+void bench_tail(size_t npoints)
+{
+    const size_t nqueries = 1000000;
+    real_grid grid(-5., 5., npoints);
+    std::function<real_type(real_type)> f = [](real_type x){ return 1.0 / (1.0 + x*x); };
+    grid_object<real_type, real_grid> g(grid);
+    g.fill(f);
+    g.set_tail(f);
+
+    std::mt19937 gen(42);
+    std::uniform_real_distribution<real_type> dist(-10., 10.);
+    std::vector<real_type> x(nqueries);
+    for (auto& q : x) q = dist(gen);
+
+    real_type fs = 0;
+    double t_try = timeit([&](){ for (auto q : x) fs += g(q); }, 1) / nqueries;
+    double t_catch = timeit([&](){ for (auto q : x) { 
+        try { fs += grid.eval(g.data(), q); } catch (gftools_exception&) { fs += f(q); } 
+        } }, 1) / nqueries;
+    INFO("grid_object on " << npoints << " points, half of the queries in the tail, time per query:");
+    INFO2("operator()          : " << t_try << " s");
+    INFO2("eval + catch + tail : " << t_catch << " s (" << t_catch / t_try << "x)");
+    INFO("checksum : " << fs);
+}
+
+int main(int argc, char *argv[])
+{
+    bench(1000);
+    bench(100000);
+    bench(1000000);
+    bench_tail(1000);
+}
@@ -0,0 +1,52 @@
+/** 
+ * Microbenchmark of a self-consistency-like loop over q-points, that creates temporary grid_objects of equal shapes 
+ * (g * g.shift(q), conj(), +) :
+ *  - with a fresh allocation of each temporary (malloc/free and page faults for large buffers)
+ *  - with the temporaries recycled by a workspace
+ * Build with -DCMAKE_BUILD_TYPE=Release for meaningful timings.
+ */
+
+#include <chrono>
+#include <gftools.hpp>
+
+using namespace gftools;
+
+template <typename F>
+double timeit(F&& f, int nrepeat)
+{
+    auto t0 = std::chrono::steady_clock::now();
+    for (int r=0; r<nrepeat; r++) f();
+    auto t1 = std::chrono::steady_clock::now();
+    return std::chrono::duration<double>(t1-t0).count() / nrepeat;
+}
+
+int main(int argc, char *argv[])
+{
+    const int nw = 32, nk = 32, nq = 16;
+    const int nrepeat = 3;
+    fmatsubara_grid fgrid(-nw/2, nw/2, 10.0);
+    kmesh kgrid(nk);
+    typedef grid_object<complex_type, fmatsubara_grid, kmesh, kmesh> gk_type;
+    gk_type gk(std::make_tuple(fgrid, kgrid, kgrid));
+    const real_type mu = 0.3;
+    gk.fill([mu](complex_type w, real_type kx, real_type ky){ return 1.0 / (w + mu + 2.0*(cos(kx) + cos(ky))); });
+
+    complex_type s = 0.0;
+    auto loop = [&](){ 
+        for (int q = 0; q < nq; ++q) { 
+            gk_type chi = (gk * gk.shift(std::make_tuple(0.0, kgrid[q].value(), kgrid[q/2].value()))).conj();
+            chi += gk * 2.0;
+            s += chi.sum();
+            }
+        };
+
+    double t_malloc = timeit(loop, nrepeat);
+    workspace ws;
+    double t_ws = timeit([&](){ workspace::scope scope(ws); loop(); }, nrepeat);
+
+    INFO(nq << " q-points of " << gk.size() << " values, time per q-point :");
+    INFO2("fresh allocations : " << t_malloc / nq << " s");
+    INFO2("workspace         : " << t_ws / nq << " s (" << t_malloc / t_ws << "x faster)");
+    INFO(ws.stats());
+    INFO("checksum : " << s);
+}
@@ -0,0 +1,55 @@
+#  Try to find FFTW3 (double precision). Once done this will define
+#  FFTW_FOUND - System has FFTW
+#  FFTW_INCLUDE_DIRS - The FFTW include directories
+#  FFTW_LIBRARIES - The libraries needed to use FFTW
+#  FFTW_THREADS_FOUND - FFTW threads support is found and added to FFTW_LIBRARIES : fftw3_threads, or fftw3_omp with OpenMP
+#  FFTW_DEFINITIONS - Compiler switches required for using FFTW (GFTOOLS_FFTW_THREADS, if threads are found)
+
+find_package(PkgConfig)
+pkg_check_modules(PC_FFTW QUIET fftw3)
+
+find_path(FFTW_INCLUDE_DIR fftw3.h
+          HINTS ${PC_FFTW_INCLUDEDIR} ${PC_FFTW_INCLUDE_DIRS} ${FFTW_ROOT}/include $ENV{FFTW_ROOT}/include
+         )
+
+find_library(FFTW_LIBRARY NAMES fftw3
+             HINTS ${PC_FFTW_LIBDIR} ${PC_FFTW_LIBRARY_DIRS} ${FFTW_ROOT}/lib $ENV{FFTW_ROOT}/lib
+            )
+
+find_library(FFTW_THREADS_LIBRARY NAMES fftw3_threads
+             HINTS ${PC_FFTW_LIBDIR} ${PC_FFTW_LIBRARY_DIRS} ${FFTW_ROOT}/lib $ENV{FFTW_ROOT}/lib
+            )
+find_library(FFTW_OMP_LIBRARY NAMES fftw3_omp
+             HINTS ${PC_FFTW_LIBDIR} ${PC_FFTW_LIBRARY_DIRS} ${FFTW_ROOT}/lib $ENV{FFTW_ROOT}/lib
+            )
+
+set(FFTW_INCLUDE_DIRS ${FFTW_INCLUDE_DIR} )
+set(FFTW_LIBRARIES ${FFTW_LIBRARY} )
+set(FFTW_DEFINITIONS "")
+if (FFTW_THREADS_LIBRARY)
+    set(FFTW_THREADS_FOUND TRUE)
+    find_package(Threads)
+    set(FFTW_LIBRARIES ${FFTW_THREADS_LIBRARY} ${FFTW_LIBRARY} ${CMAKE_THREAD_LIBS_INIT})
+    set(FFTW_DEFINITIONS GFTOOLS_FFTW_THREADS)
+elseif (FFTW_OMP_LIBRARY)
+    # fftw3_omp needs the OpenMP runtime
+    find_package(OpenMP)
+    if (OPENMP_FOUND OR OpenMP_CXX_FOUND)
+        set(FFTW_THREADS_FOUND TRUE)
+        if (TARGET OpenMP::OpenMP_CXX)
+            # the installed gftools target links with the OpenMP flags, since it doesn't look for OpenMP
+            set(FFTW_LIBRARIES ${FFTW_OMP_LIBRARY} ${FFTW_LIBRARY} 
+                $<BUILD_INTERFACE:OpenMP::OpenMP_CXX> $<INSTALL_INTERFACE:${OpenMP_CXX_FLAGS}>)
+        else ()
+            set(FFTW_LIBRARIES ${FFTW_OMP_LIBRARY} ${FFTW_LIBRARY} ${OpenMP_CXX_FLAGS})
+        endif ()
+        set(FFTW_DEFINITIONS GFTOOLS_FFTW_THREADS)
+    endif ()
+endif ()
+
+include(FindPackageHandleStandardArgs)
+# handle the QUIETLY and REQUIRED arguments and set FFTW_FOUND to TRUE
+# if all listed variables are TRUE
+find_package_handle_standard_args(FFTW "No FFTW found" FFTW_LIBRARY FFTW_INCLUDE_DIR)
+
+mark_as_advanced(FFTW_INCLUDE_DIR FFTW_LIBRARY FFTW_THREADS_LIBRARY FFTW_OMP_LIBRARY)
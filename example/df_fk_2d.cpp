@@ -14,6 +14,9 @@
 #include <boost/program_options.hpp>
 #include <gftools.hpp>
 #include <Eigen/Core>
+#ifdef GFTOOLS_USE_FFTW
+#include <gftools/fft.hpp>
+#endif
 
 namespace po = boost::program_options;
 using namespace gftools;
@@ -109,20 +112,29 @@ int main(int argc, char *argv[])
     gk_type sigma_dual(gd0.grids());
     sigma_dual = 0.0;
     disp_type bare_bubbles(kgrid,kgrid);
+#ifdef GFTOOLS_USE_FFTW
+    // Evaluate -T \sum_k G_{w,k} G_{w,k+q} for all q at once : FFT to the lattice, multiply and FFT back. 
+    gk_type bubbles_wq(gd0.grids(), -T * fft_convolve<1,2>(gd0, gd0).data());
+    // diagonal part of the full vertex for all q
+    gk_type vertex_wq(gd0.grids());
+#endif
 
     // now loop through the BZ (no irreducible part optimization)
     for (kmesh::point q1 : kgrid.points()) { 
         for (kmesh::point q2 : kgrid.points()) { 
             std::cout << "[" << q1.index()*kpts + q2.index()+1 << "/" << totalkpts <<  "]; q = {" <<  q1.value() << " " << q2.value() << "}" << std::endl;
+            gw_type dual_bubble(fgrid);
+#ifdef GFTOOLS_USE_FFTW
+            for (auto w : fgrid.points()) { dual_bubble[w] = bubbles_wq(w, q1, q2); }
+#else
             // Evaluate -T \sum_k G_{w,k} G_{w,k+q}
             // Shift dual g in k-space and make no frequency shift. 
-            // note : this operation is typically optimized via an fft. 
             gk_type gd0_shift = gd0.shift(std::make_tuple(0.0,q1,q2)); 
-            // obtain a bubble 
-            gk_type bubble_wk = -T * gd0 * gd0_shift;
+            // obtain a bubble (the expression of containers is evaluated in a single pass) 
+            gk_type bubble_wk(gd0.grids(), -T * gd0.data() * gd0_shift.data());
             // perform sum over k    
-            gw_type dual_bubble(fgrid);
             for (auto w : fgrid.points()) { dual_bubble[w] = bubble_wk[w].sum() / double(totalkpts); }
+#endif
             // save the bubble for output 
             bare_bubbles(q1, q2) = dual_bubble.sum();
             // construct a diagonal matrix (in frequency space from the bubble)
@@ -133,10 +145,19 @@ int main(int argc, char *argv[])
             for (int n=0; n<diagram_order; n++) 
                 full_vertex_matrix= gamma4_matrix * dual_bubble_matrix * full_vertex_matrix; 
             // update self-energy
+#ifdef GFTOOLS_USE_FFTW
+            for (auto w : fgrid.points())
+                vertex_wq(w, q1, q2) = full_vertex_matrix(w.index(), w.index());
+#else
             for (auto w : fgrid.points())
                 sigma_dual[w.index()] += T* full_vertex_matrix(w.index(), w.index()) * gd0_shift[w.index()] / double(totalkpts);
+#endif
         }
     }
+#ifdef GFTOOLS_USE_FFTW
+    // sigma(w,k) = T/N_q \sum_q V(w,q) G(w,k+q)
+    sigma_dual = gk_type(gd0.grids(), T * fft_convolve<1,2>(vertex_wq, gd0).data());
+#endif
     // output
     // save bare bubbles
     bare_bubbles.savetxt("db0.dat");
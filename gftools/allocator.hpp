@@ -0,0 +1,138 @@
+#pragma once
+
+/// \file : allocator.hpp
+/// The allocator of the memory of containers : cache line (64 byte) aligned blocks, so that SIMD loads of Eigen and FFTW
+/// and the chunks of parallel loops start at aligned addresses. Large blocks can be backed by transparent huge pages
+/// (see set_huge_page_threshold), which cuts TLB misses on multi-GB objects. Blocks can be recycled by a workspace (workspace.hpp).
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <limits>
+#include <new>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <sys/mman.h>
+#define GFTOOLS_POSIX_MEMALIGN
+#endif
+
+namespace gftools {
+
+/// alignment of the memory of containers in bytes
+constexpr size_t default_alignment = 64;
+/// size of a transparent huge page on x86-64 and aarch64 (blocks, that use huge pages, are aligned to it)
+constexpr size_t huge_page_size = size_t(2) << 20;
+
+namespace extra {
+inline std::atomic<size_t>& huge_page_threshold_()
+{
+#ifdef GFTOOLS_HUGE_PAGES
+    static std::atomic<size_t> n(size_t(32) << 20);
+#else
+    static std::atomic<size_t> n(0);
+#endif
+    return n;
+}
+
+/// allocate bytes aligned to alignment (a power of 2, at least sizeof(void*)). Throws std::bad_alloc.
+inline void* aligned_malloc(size_t bytes, size_t alignment)
+{
+    if (bytes == 0) bytes = 1;
+#ifdef GFTOOLS_POSIX_MEMALIGN
+    void* p = nullptr;
+    if (::posix_memalign(&p, alignment, bytes) != 0) throw std::bad_alloc();
+    return p;
+#else
+    // keep the address of the malloc'ed block right before the aligned one
+    void* raw = std::malloc(bytes + alignment + sizeof(void*));
+    if (!raw) throw std::bad_alloc();
+    std::uintptr_t address = (reinterpret_cast<std::uintptr_t>(raw) + sizeof(void*) + alignment - 1) & ~std::uintptr_t(alignment - 1);
+    reinterpret_cast<void**>(address)[-1] = raw;
+    return reinterpret_cast<void*>(address);
+#endif
+}
+
+inline void aligned_free(void* p)
+{
+#ifdef GFTOOLS_POSIX_MEMALIGN
+    std::free(p);
+#else
+    if (p) std::free(static_cast<void**>(p)[-1]);
+#endif
+}
+
+/// allocate bytes aligned to alignment, blocks above huge_page_threshold() are aligned to huge pages and advised to use them
+inline void* allocate_block(size_t bytes, size_t alignment)
+{
+    const size_t threshold = huge_page_threshold_().load();
+    if (threshold == 0 || bytes < threshold) return aligned_malloc(bytes, alignment);
+    void* p = aligned_malloc(bytes, huge_page_size > alignment ? huge_page_size : alignment);
+#if defined(GFTOOLS_POSIX_MEMALIGN) && defined(MADV_HUGEPAGE)
+    // only a hint : the kernel may ignore it (e.g. with transparent huge pages disabled)
+    ::madvise(p, bytes, MADV_HUGEPAGE);
+#endif
+    return p;
+}
+
+/** A source of recycled blocks for aligned_allocator in the calling thread (see workspace.hpp). 
+ * take returns nullptr, if there is no block of that size; give returns false, if the block should be freed instead. */
+struct block_source {
+    virtual void* take(size_t bytes, size_t alignment) = 0;
+    virtual bool give(void* p, size_t bytes, size_t alignment) = 0;
+protected:
+    ~block_source() = default;
+};
+/// the block source of the calling thread (nullptr - allocate and free directly)
+inline block_source*& current_block_source_() { static thread_local block_source* s = nullptr; return s; }
+} // end of namespace extra
+
+/// blocks of at least that many bytes are backed by transparent huge pages (0 - never, which is the default without GFTOOLS_HUGE_PAGES)
+inline size_t huge_page_threshold() { return extra::huge_page_threshold_().load(); }
+inline void set_huge_page_threshold(size_t bytes) { extra::huge_page_threshold_() = bytes; }
+
+/** An allocator of Alignment-aligned memory (a power of 2, 64 by default). It is the default allocator of containers;
+ * other allocators (e.g. for NUMA placement) can be given as the last template parameter of container. */
+template <typename T, size_t Alignment = default_alignment>
+struct aligned_allocator {
+    static_assert(Alignment >= sizeof(void*) && (Alignment & (Alignment - 1)) == 0, "Alignment should be a power of 2");
+    typedef T value_type;
+    typedef T* pointer;
+    typedef T const* const_pointer;
+    typedef T& reference;
+    typedef T const& const_reference;
+    typedef size_t size_type;
+    typedef std::ptrdiff_t difference_type;
+    template <typename U> struct rebind { typedef aligned_allocator<U, Alignment> other; };
+    static constexpr size_t alignment = Alignment;
+
+    aligned_allocator() = default;
+    template <typename U> aligned_allocator(aligned_allocator<U, Alignment> const&) {}
+
+    T* allocate(size_t n)
+    {
+        if (n > std::numeric_limits<size_t>::max() / sizeof(T)) throw std::bad_alloc();
+        if (extra::block_source* source = extra::current_block_source_()) 
+            if (void* p = source->take(n * sizeof(T), alignment_())) return static_cast<T*>(p);
+        return static_cast<T*>(extra::allocate_block(n * sizeof(T), alignment_()));
+    }
+    void deallocate(T* p, size_t n) 
+    { 
+        extra::block_source* source = extra::current_block_source_();
+        if (!source || !source->give(p, n * sizeof(T), alignment_())) extra::aligned_free(p); 
+    }
+    size_t max_size() const { return std::numeric_limits<size_t>::max() / sizeof(T); }
+protected:
+    static constexpr size_t alignment_() { return Alignment > alignof(T) ? Alignment : alignof(T); }
+};
+
+template <typename T, typename U, size_t A>
+bool operator== (aligned_allocator<T,A> const&, aligned_allocator<U,A> const&) { return true; }
+template <typename T, typename U, size_t A>
+bool operator!= (aligned_allocator<T,A> const&, aligned_allocator<U,A> const&) { return false; }
+
+/// container (see container.hpp) stores its data with aligned_allocator by default
+template <typename ValueType, size_t N, typename Allocator = aligned_allocator<ValueType>>
+struct container;
+
+} // end of namespace gftools
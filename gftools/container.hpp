@@ -16,6 +16,11 @@
 #include <boost/iterator/iterator_facade.hpp>
 
 #include "tuple_tools.hpp"
+#include "math_expression.hpp"
+#include "eval_expression.hpp"
+#include "parallel.hpp"
+#include "allocator.hpp"
+#include "workspace.hpp"
 
 namespace gftools { 
 
@@ -26,8 +31,9 @@ namespace gftools {
 template <typename ValueType, size_t N, typename BoostContainerType>
 struct container_base;
 
-/// container is a multidimensional array with math operations, that allocates and stores memory
-template <typename ValueType, size_t N>
+/// container is a multidimensional array with math operations, that allocates and stores memory with Allocator 
+/// (64 byte aligned by default, see allocator.hpp)
+template <typename ValueType, size_t N, typename Allocator>
 struct container;
 
 /// container_view is a "view" of a container_base that allows to access elements with a different storage order
@@ -74,19 +80,13 @@ struct container_base
     /// Is2d defines true_type if the objectr is 2d -> allows matrix operations
     template <size_t N2 = N, typename DT = boost_t>
     using Is2d = typename std::enable_if<N2==2,DT>::type;
-    // helper typedefs for math operations (to be able to multiply container and a ref, container and container, container and a number etc)
-    /// BaseRefIfContainer defines container_base type if the template parameter T is a container_base 
-    template <typename T>
-    using BaseRefIfContainer = typename std::enable_if<T::N_>=1, container_base<ValueType,N,boost_t>&>::type;
-    /// ContaierIfContainer defines container type if the template parameter T is a container_base 
+    // helper typedefs for math operations (to be able to add to a container a container, a ref, an expression or a number)
+    /// BaseRefIfContainer defines container_base type if the template parameter T is a container_base or a math_expr
     template <typename T>
-    using ContainerIfContainer = typename std::enable_if<T::N_>=1, container<ValueType,N>>::type;
+    using BaseRefIfContainer = typename std::enable_if<is_math_operand<T>::value, container_base<ValueType,N,boost_t>&>::type;
     /// BaseRefIfValue defines container_base if the template parameter T is a number
     template <typename T>
     using BaseRefIfValue = typename std::enable_if<std::is_convertible<T,ValueType>::value, container_base<ValueType,N,boost_t>&>::type;
-    /// BaseRefIfValue defines container if the template parameter T is a number
-    template <typename T>
-    using ContainerIfValue = typename std::enable_if<std::is_convertible<T,ValueType>::value, container<ValueType,N>>::type;
 
     // iterators
     /// typedef for an operation that converts a operator[] of wrapped multi_array into operator[] of container
@@ -120,15 +120,24 @@ struct container_base
     /// assign from a number
     template <typename T> 
         typename std::enable_if<std::is_convertible<T,ValueType>::value,container_base&>::type operator=(T rhs);// { Base(*this) = rhs; return (*this);}
+    /// assign from a block of another container, obtained with operator[]
+    template <size_t M>
+        container_base& operator=(const flat_eval_expression<ValueType,M,N>& rhs) { return (*this) = rhs.view(); }
+    /// assign from an expression - evaluates it in one pass
+    template <typename L, typename Op, typename R>
+        container_base& operator=(const math_expr<L,Op,R>& rhs);
     /// assign from matrix (2d containers only)
     template<size_t N2 = N, typename U = Is2d<N2>>
     container_base<ValueType,N,boost_t>& operator=(MatrixType rhs);
 
     // access operations
-    /// access rank N-1 object
-    auto operator[](size_t i) -> under_ref_type { return under_ref_type(storage_[i]); }
-    /// const access rank N-1 object
-    auto operator[](size_t i) const -> under_ref_type const { return under_ref_type(storage_[i]); }
+    /// access rank N-1 object - returns a flat_eval_expression, that collects the offset of chained operator[] 
+    template <size_t M = N>
+        typename std::enable_if<(M>1 && !is_view_), under_ref_type>::type operator[](size_t i) const 
+            { return under_ref_type(storage_.origin(), storage_.strides(), storage_.shape(), storage_.strides()[0]*i); }
+    /// access a value (1d container)
+    template <size_t M = N>
+        typename std::enable_if<(M==1 || is_view_), under_ref_type>::type operator[](size_t i) const { return under_ref_type(storage_[i]); }
     /// return value ref from an array of indices
     ValueType& operator()(std::array<size_t, N> indices){return storage_(indices);}
     /// return value const-ref from an array of indices
@@ -186,47 +195,26 @@ struct container_base
     iterator end();
     
     // Mathematical operations
+    // Binary operations (+,-,*,/) are defined in math_expression.hpp and return lazy math_expr objects
     template <typename R>
         BaseRefIfContainer<R> operator+=(const R &rhs); 
-    template <typename R> 
-        ContainerIfContainer<R> operator+(const R &rhs) const;
     template <typename R2>
         BaseRefIfValue<R2> operator+=(const R2& rhs);
-    template <typename R2> 
-        ContainerIfValue<R2> operator+(const R2& rhs) const;
 
     template <typename R>
         BaseRefIfContainer<R> operator-=(const R &rhs); 
-    template <typename R> 
-        ContainerIfContainer<R> operator-(const R &rhs) const;
     template <typename R2> 
         BaseRefIfValue<R2> operator-=(const R2& rhs);
-    template <typename R2> 
-        ContainerIfValue<R2> operator-(const R2& rhs) const;
 
     template <typename R>
         BaseRefIfContainer<R> operator*=(const R &rhs); 
-    template <typename R> 
-        ContainerIfContainer<R> operator*(const R &rhs) const;
     template <typename R2> 
         BaseRefIfValue<R2> operator*=(const R2& rhs);
-    template <typename R2> 
-        ContainerIfValue<R2> operator*(const R2& rhs) const;
 
     template <typename R>
         BaseRefIfContainer<R> operator/=(const R &rhs); 
-    template <typename R> 
-        ContainerIfContainer<R> operator/(const R &rhs) const;
     template <typename R2> 
         BaseRefIfValue<R2> operator/=(const R2& rhs);
-    template <typename R2> 
-        ContainerIfValue<R2> operator/(const R2& rhs) const;
-
-    friend container<ValueType,N> operator* (const ValueType & lhs, const container_base<ValueType,N,boost_t> & rhs) {return rhs*lhs;};
-    friend container<ValueType,N> operator+ (const ValueType & lhs, const container_base<ValueType,N,boost_t> & rhs) {return rhs+lhs;};
-    friend container<ValueType,N> operator- (const ValueType & lhs, const container_base<ValueType,N,boost_t> & rhs) {return rhs*(-1.0)+lhs;};
-    friend container<ValueType,N> operator/ (const ValueType & lhs, const container_base<ValueType,N,boost_t> & rhs) {
-        container<ValueType,N> out(rhs); out=lhs; return out/rhs;};
     
     /// An exception provided for incorrect indices 
     class ex_wrong_index : public std::exception { virtual const char* what() const throw(){return "Index out of bounds";}}; 
@@ -235,17 +223,22 @@ struct container_base
     /// underscore is added to discourage from using the method
     boost_t& boost_container_() const {return storage_; }
 protected:
+    /// tag of the constructor, that allocates the storage of a given shape in place (without copying a temporary multi_array)
+    struct shape_tag {};
+    template <typename Shape>
+        container_base(shape_tag, Shape const& shape):storage_(shape){};
     /// allow other container t access internal storage
-    friend struct container<ValueType,N>;
+    template <typename V2, size_t N2, typename A2> friend struct container;
     /// wrapped boost multi_array
     // it is mutable, because Eigen::Map operates with * pointers
     // FIXME - remove mutable
     mutable boost_t storage_;
 };
 
-template <typename ValueType, size_t N>
-struct container : container_base<ValueType,N,typename boost::multi_array<ValueType, N>> {
-    typedef boost::multi_array<ValueType, N> boost_t;
+template <typename ValueType, size_t N, typename Allocator>
+struct container : container_base<ValueType,N,typename boost::multi_array<ValueType, N, Allocator>> {
+    typedef boost::multi_array<ValueType, N, Allocator> boost_t;
+    typedef Allocator allocator_type;
     typedef container_base<ValueType,N,boost_t> Base;
     using Base::storage_;
     typedef typename Base::MatrixType MatrixType;
@@ -255,16 +248,22 @@ struct container : container_base<ValueType,N,typename boost::multi_array<ValueT
     using IsNotContainer = typename std::enable_if<!(T::N_>=1)>::type;
 
     /// construct container from a given shape of ints (initialize with zeros)
-    container(std::array<int,N> shape):container_base<ValueType,N,typename boost::multi_array<ValueType, N>>(boost::multi_array<ValueType, N>(shape)) {};
+    container(std::array<int,N> shape):Base(typename Base::shape_tag(), shape) {};
     /// construct container from a given shape of size_t (initialize with zeros) 
-    explicit container(std::array<size_t,N> shape):container_base<ValueType,N,typename boost::multi_array<ValueType, N>>(boost::multi_array<ValueType, N>(shape)) {};
+    explicit container(std::array<size_t,N> shape):Base(typename Base::shape_tag(), shape) {};
     /// construct container from an initializer list of ints, aka container<double, 2> a({{1,2}})
-    container(std::initializer_list<int> shape):container_base<ValueType,N,typename boost::multi_array<ValueType, N>>(boost::multi_array<ValueType, N>(std::array<int, N>(shape))) {};
+    container(std::initializer_list<int> shape):Base(typename Base::shape_tag(), std::array<int, N>(shape)) {};
 
     /// construct from a different container_base 
     // using value here is safe with a move constructor
     template <typename CT>
-        container(container_base<ValueType,N,CT> in) : container_base<ValueType,N,typename boost::multi_array<ValueType, N>>(in.storage_) {};
+        container(container_base<ValueType,N,CT> in) : Base(in.storage_) {};
+    /// construct from a block of another container, obtained with operator[]
+    template <size_t M>
+        container(const flat_eval_expression<ValueType,M,N>& in) : container(in.view()) {};
+    /// construct from an expression - evaluates it in one pass
+    template <typename L, typename Op, typename R>
+        container(const math_expr<L,Op,R>& in);
     container(container const&) = default;
     container(container &&) = default;
     container& operator=(container &&) = default;
@@ -276,12 +275,12 @@ struct container : container_base<ValueType,N,typename boost::multi_array<ValueT
                && (std::is_convertible<std::tuple<ShapeArgs...>, typename tuple_tools::repeater<int,N>::tuple_type>::value // Arguments have to be strictly ints
                || std::is_convertible<std::tuple<ShapeArgs...>, typename tuple_tools::repeater<size_t,N>::tuple_type>::value) // or size_t
         ,int>::type>
-        container(ShapeArgs...in):container_base<ValueType,N,typename boost::multi_array<ValueType, N>>(boost::multi_array<ValueType, N>(std::array<int,N>({{static_cast<int>(in)...}}))) {
+        container(ShapeArgs...in):Base(typename Base::shape_tag(), std::array<int,N>({{static_cast<int>(in)...}})) {
             static_assert(sizeof...(in) == N,"arg mismatch");
         };
     /// construct 2d container from matrix
     template<size_t N2 = N, typename U = typename std::enable_if<N2==2, bool>::type> 
-        container<ValueType,N> (MatrixType rhs);
+        container (MatrixType rhs);
 
     // inherit math from base
     using Base::operator+=;
@@ -303,10 +302,10 @@ struct container_traits<container_base<ValueType,N,BoostContainerType>,false>
     typedef BoostContainerType boost_t;
     /// typedef for a result of const operator[] operation (i.e. can be an array or a number) 
     typedef typename boost_t::reference boost_under_type;
-    /// typedef for a result of operator[] operation (i.e. can be an array or a number) 
+    /// typedef for a result of dereferencing an iterator (a view of rank N-1)
     typedef container_base<ValueType,N-1,boost_under_type> type;
-    /// typedef for a resukt of operator[] of underlying boost::multi_array type
-    typedef container_base<ValueType,N-1,boost_under_type> ref_type;
+    /// typedef for a result of operator[] operation - an expression, that collects indices of chained operator[]
+    typedef flat_eval_expression<ValueType,N,N-1> ref_type;
 };
 
 /// type traits for container/container_base of rank==1
@@ -19,7 +19,10 @@ std::ostream& operator<<(std::ostream& lhs, const container_base<ValueType,N, Bo
 template <typename ValueType, size_t N, typename BoostCType> 
 ValueType container_base<ValueType,N, BoostCType>::sum() const 
 {
-    return EigenMap(storage_.origin(), storage_.num_elements()).sum();
+    EigenMap map1(storage_.origin(), storage_.num_elements());
+    return parallel::reduce<ValueType>(map1.size(), 
+        [&](size_t b, size_t e){ return ValueType(map1.segment(b, e-b).sum()); }, 
+        [](ValueType x, ValueType y){ return x + y; });
 };
 
 template <typename ValueType, size_t N, typename BoostCType> 
@@ -33,10 +36,15 @@ template <typename V2, typename DT>
 double container_base<ValueType,N, BoostCType>::diff(const container_base<V2,N,DT>& r, bool norm) const
 {   
     assert(this->size() == r.size());
-    double d = 0;
-    for (int i=0; i<this->size(); i++) {
-        d+=std::abs(*(this->data() + i) - *(r.data()+i));
-        }
+    const ValueType* l_data = this->data();
+    const V2* r_data = r.data();
+    double d = parallel::reduce<double>(this->size(), [&](size_t b, size_t e){ 
+        double d = 0;
+        for (size_t i=b; i<e; i++) {
+            d+=std::abs(*(l_data + i) - *(r_data + i));
+            }
+        return d;
+        }, [](double x, double y){ return x + y; });
     return d/double(norm?this->size():1);
 }
 
@@ -63,10 +71,10 @@ template<size_t N2, typename U>
     return Map1;
 }
 
-template <typename ValueType, size_t N> 
+template <typename ValueType, size_t N, typename Allocator> 
 template <size_t N2, typename>
-container<ValueType,N>::container(MatrixType rhs):
-    container<ValueType,N>(std::array<size_t,2>({{static_cast<size_t>(rhs.rows()), static_cast<size_t>(rhs.cols()) }}))
+container<ValueType,N,Allocator>::container(MatrixType rhs):
+    container<ValueType,N,Allocator>(std::array<size_t,2>({{static_cast<size_t>(rhs.rows()), static_cast<size_t>(rhs.cols()) }}))
 {
     std::copy(rhs.data(), rhs.data()+rhs.rows()*rhs.cols(), storage_.origin());
 }
@@ -128,7 +136,8 @@ template <typename T>
     typename std::enable_if<std::is_convertible<T,ValueType>::value,container_base<ValueType,N,BoostCType>&>::type 
     container_base<ValueType,N,BoostCType>::operator=(T rhs)
 {
-    std::fill(storage_.origin(), storage_.origin()+storage_.num_elements(), rhs);
+    ValueType* data = storage_.origin();
+    parallel::for_each_chunk(data, storage_.num_elements(), [&](size_t b, size_t e){ std::fill(data + b, data + e, rhs); });
     return *this;
 }
 
@@ -163,156 +172,100 @@ typename container_base<ValueType, N, BoostCType>::iterator container_base<Value
 
 
 template <typename ValueType, size_t N, typename BoostCType> 
-template <typename R> 
-typename container_base<ValueType,N,BoostCType>::template BaseRefIfContainer<R> container_base<ValueType,N,BoostCType>::operator+=(const R &rhs)
+template <typename L, typename Op, typename R> 
+container_base<ValueType,N,BoostCType>& container_base<ValueType,N,BoostCType>::operator=(const math_expr<L,Op,R>& rhs)
 {
     EigenMap map1(storage_.origin(),storage_.num_elements());
-    typename R::EigenMap map2(rhs.boost_container_().origin(),rhs.boost_container_().num_elements());
-    map1+=map2;
+    parallel::for_each_chunk(map1.data(), map1.size(), [&](size_t b, size_t e){ map1.segment(b,e-b)=rhs.eigen(map1.size()).segment(b,e-b); });
     return (*this);
 }
 
-template <typename ValueType, size_t N, typename BoostCType> 
-template <typename R2> 
-typename container_base<ValueType,N,BoostCType>::template BaseRefIfValue<R2> container_base<ValueType,N,BoostCType>::operator+=(const R2& rhs)
+template <typename ValueType, size_t N, typename Allocator> 
+template <typename L, typename Op, typename R> 
+container<ValueType,N,Allocator>::container(const math_expr<L,Op,R>& in):
+    container<ValueType,N,Allocator>(in.shape())
 {
-    EigenMap map1(storage_.origin(),storage_.num_elements());
-    map1+=rhs;
-    return (*this);
+    static_cast<Base&>(*this) = in;
 }
 
+
 template <typename ValueType, size_t N, typename BoostCType> 
-template <typename R>
-typename container_base<ValueType,N,BoostCType>::template ContainerIfContainer<R> container_base<ValueType,N,BoostCType>::operator+(const R &rhs) const
+template <typename R> 
+typename container_base<ValueType,N,BoostCType>::template BaseRefIfContainer<R> container_base<ValueType,N,BoostCType>::operator+=(const R &rhs)
 {
-    container<ValueType,N> out(*this); 
-    out+=rhs; 
-    return out;
+    EigenMap map1(storage_.origin(),storage_.num_elements());
+    auto rhs_node = extra::make_math_node(rhs);
+    parallel::for_each_chunk(map1.data(), map1.size(), [&](size_t b, size_t e){ map1.segment(b,e-b)+=rhs_node.eigen(map1.size()).segment(b,e-b); });
+    return (*this);
 }
 
 template <typename ValueType, size_t N, typename BoostCType> 
-template <typename R2>
-typename container_base<ValueType,N,BoostCType>::template ContainerIfValue<R2> container_base<ValueType,N,BoostCType>::operator+(const R2& rhs) const
+template <typename R2> 
+typename container_base<ValueType,N,BoostCType>::template BaseRefIfValue<R2> container_base<ValueType,N,BoostCType>::operator+=(const R2& rhs)
 {
-    container<ValueType,N> out(*this); 
-    out+=rhs; 
-    return out;
+    EigenMap map1(storage_.origin(),storage_.num_elements());
+    parallel::for_each_chunk(map1.data(), map1.size(), [&](size_t b, size_t e){ map1.segment(b,e-b)+=rhs; });
+    return (*this);
 }
 
 
-
 template <typename ValueType, size_t N, typename BoostCType> 
-template <typename R>
+template <typename R> 
 typename container_base<ValueType,N,BoostCType>::template BaseRefIfContainer<R> container_base<ValueType,N,BoostCType>::operator-=(const R &rhs)
 {
     EigenMap map1(storage_.origin(),storage_.num_elements());
-    typename R::EigenMap map2(rhs.boost_container_().origin(),rhs.boost_container_().num_elements());
-    map1-=map2;
+    auto rhs_node = extra::make_math_node(rhs);
+    parallel::for_each_chunk(map1.data(), map1.size(), [&](size_t b, size_t e){ map1.segment(b,e-b)-=rhs_node.eigen(map1.size()).segment(b,e-b); });
     return (*this);
 }
- 
+
 template <typename ValueType, size_t N, typename BoostCType> 
-template <typename R2>
+template <typename R2> 
 typename container_base<ValueType,N,BoostCType>::template BaseRefIfValue<R2> container_base<ValueType,N,BoostCType>::operator-=(const R2& rhs)
 {
     EigenMap map1(storage_.origin(),storage_.num_elements());
-    map1-=rhs;
+    parallel::for_each_chunk(map1.data(), map1.size(), [&](size_t b, size_t e){ map1.segment(b,e-b)-=rhs; });
     return (*this);
 }
 
-template <typename ValueType, size_t N, typename BoostCType> 
-template <typename R>
-typename container_base<ValueType,N,BoostCType>::template ContainerIfContainer<R> container_base<ValueType,N,BoostCType>::operator-(const R &rhs) const
-{
-    container<ValueType,N> out(*this); 
-    out-=rhs; 
-    return out;
-}
-
-template <typename ValueType, size_t N, typename BoostCType> 
-template <typename R2>
-typename container_base<ValueType,N,BoostCType>::template ContainerIfValue<R2> container_base<ValueType,N,BoostCType>::operator-(const R2& rhs) const
-{
-    container<ValueType,N> out(*this); 
-    out-=rhs; 
-    return out;
-}
-
-
 
 template <typename ValueType, size_t N, typename BoostCType> 
-template <typename R>
+template <typename R> 
 typename container_base<ValueType,N,BoostCType>::template BaseRefIfContainer<R> container_base<ValueType,N,BoostCType>::operator*=(const R &rhs)
 {
     EigenMap map1(storage_.origin(),storage_.num_elements());
-    typename R::EigenMap map2(rhs.boost_container_().origin(),rhs.boost_container_().num_elements());
-
-    map1*=map2;
+    auto rhs_node = extra::make_math_node(rhs);
+    parallel::for_each_chunk(map1.data(), map1.size(), [&](size_t b, size_t e){ map1.segment(b,e-b)*=rhs_node.eigen(map1.size()).segment(b,e-b); });
     return (*this);
 }
 
 template <typename ValueType, size_t N, typename BoostCType> 
-template <typename R2>
+template <typename R2> 
 typename container_base<ValueType,N,BoostCType>::template BaseRefIfValue<R2> container_base<ValueType,N,BoostCType>::operator*=(const R2& rhs)
 {
     EigenMap map1(storage_.origin(),storage_.num_elements());
-    map1*=rhs;
+    parallel::for_each_chunk(map1.data(), map1.size(), [&](size_t b, size_t e){ map1.segment(b,e-b)*=rhs; });
     return (*this);
 }
 
-template <typename ValueType, size_t N, typename BoostCType> 
-template <typename R>
-typename container_base<ValueType,N,BoostCType>::template ContainerIfContainer<R> container_base<ValueType,N,BoostCType>::operator*(const R &rhs) const
-{
-    container<ValueType,N> out(*this); 
-    out*=rhs; 
-    return out;
-}
 
 template <typename ValueType, size_t N, typename BoostCType> 
-template <typename R2> 
-typename container_base<ValueType,N,BoostCType>::template ContainerIfValue<R2> container_base<ValueType,N,BoostCType>::operator*(const R2& rhs) const
-{
-    container<ValueType,N> out(*this); 
-    out*=rhs; 
-    return out;
-}
-
-template <typename ValueType, size_t N, typename BoostCType> 
-template <typename R>
+template <typename R> 
 typename container_base<ValueType,N,BoostCType>::template BaseRefIfContainer<R> container_base<ValueType,N,BoostCType>::operator/=(const R &rhs)
 {
     EigenMap map1(storage_.origin(),storage_.num_elements());
-    typename R::EigenMap map2(rhs.storage_.origin(),rhs.storage_.num_elements());
-    map1/=map2;
+    auto rhs_node = extra::make_math_node(rhs);
+    parallel::for_each_chunk(map1.data(), map1.size(), [&](size_t b, size_t e){ map1.segment(b,e-b)/=rhs_node.eigen(map1.size()).segment(b,e-b); });
     return (*this);
 }
 
 template <typename ValueType, size_t N, typename BoostCType> 
-template <typename R2>
+template <typename R2> 
 typename container_base<ValueType,N,BoostCType>::template BaseRefIfValue<R2> container_base<ValueType,N,BoostCType>::operator/=(const R2& rhs)
 {
     EigenMap map1(storage_.origin(),storage_.num_elements());
-    map1/=rhs;
+    parallel::for_each_chunk(map1.data(), map1.size(), [&](size_t b, size_t e){ map1.segment(b,e-b)/=rhs; });
     return (*this);
 }
 
-template <typename ValueType, size_t N, typename BoostCType> 
-template <typename R>
-typename container_base<ValueType,N,BoostCType>::template ContainerIfContainer<R> container_base<ValueType,N,BoostCType>::operator/(const R &rhs) const
-{
-    container<ValueType,N> out(*this); 
-    out/=rhs; 
-    return out;
-}
-
-template <typename ValueType, size_t N, typename BoostCType> 
-template <typename R2>
-typename container_base<ValueType,N,BoostCType>::template ContainerIfValue<R2> container_base<ValueType,N,BoostCType>::operator/(const R2& rhs) const
-{
-    container<ValueType,N> out(*this); 
-    out/=rhs; 
-    return out;
-}
-
 } // end of namespace GFTools
@@ -24,8 +24,8 @@ class enum_grid : public grid_base<int_wrap_enumerate_grid, enum_grid>
 {
 public:
     typedef grid_base<int_wrap_enumerate_grid, enum_grid> base; 
-    template <class Obj> auto integrate(const Obj &in) const ->decltype(in(vals_[0]));
-    template <class Obj, typename ...OtherArgTypes> auto integrate(const Obj &in, OtherArgTypes... Args) const -> decltype(in(vals_[0],Args...));
+    template <class Obj> auto integrate(const Obj &in) const ->decltype(in(std::declval<point>()));
+    template <class Obj, typename ...OtherArgTypes> auto integrate(const Obj &in, OtherArgTypes... Args) const -> decltype(in(std::declval<point>(),Args...));
     /** Generates a uniform grid.
      * \param[in] min Minimal point
      * \param[in] max Maximal point
@@ -42,6 +42,8 @@ public:
     //template <class Obj> auto gridIntegrate(std::vector<Obj> &in) -> Obj;
     template <class Obj> auto eval(Obj &in, enum_grid::point x) const -> decltype(in[0]);
     template <class Obj> auto eval(Obj &in, int x) const -> decltype(std::declval<typename std::remove_reference<decltype(in[0])>::type>()*1.0);
+    /// same as eval, but returns false instead of throwing, if x is out of the grid
+    template <class Obj, typename V> bool try_eval(Obj &in, int x, V &out) const;
     //template <class Obj> auto eval(Obj &in, EnumerateGrid::point x) const ->decltype(in[0]);
 };
 
@@ -71,9 +73,9 @@ inline enum_grid& enum_grid::operator=(enum_grid &&rhs)
 
 inline std::tuple<bool, size_t, int> enum_grid::find (int in) const
 {
-    if (in<vals_[0].value()) { ERROR("out of bounds"); return std::make_tuple(0,0,0);};
-    if (in > vals_[vals_.size()-1].value()) { ERROR("out of bounds"); return std::make_tuple(0,vals_.size(),0);}; 
-    return std::make_tuple (1,in-vals_[0].value(),1);
+    if (in<vals_[0]) { ERROR("out of bounds"); return std::make_tuple(0,0,0);};
+    if (in > vals_[vals_.size()-1]) { ERROR("out of bounds"); return std::make_tuple(0,vals_.size(),0);}; 
+    return std::make_tuple (1,in-vals_[0],1);
 }
 
 template <class Obj>
@@ -86,10 +88,18 @@ inline auto enum_grid::eval(Obj &in, int x) const ->
 }
 
 
+template <class Obj, typename V>
+inline bool enum_grid::try_eval(Obj &in, int x, V &out) const
+{
+    if (vals_.empty() || x < int(vals_[0]) || x > int(vals_[vals_.size()-1])) return false;
+    out = in[x - int(vals_[0])];
+    return true;
+}
+
 template <class Obj>
 inline auto enum_grid::eval(Obj &in, enum_grid::point x) const ->decltype(in[0]) 
 {
-    if (x.index() < vals_.size() && x == vals_[x.index()])
+    if (x.index() < vals_.size() && int(x.value()) == int(vals_[x.index()]))
     return in[x.index()];
     else { 
         #ifndef NDEBUG
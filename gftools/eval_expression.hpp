@@ -3,11 +3,24 @@
 #include <utility>
 #include <array>
 #include <cstddef>
+#include <ostream>
+#include <type_traits>
+
+#include <Eigen/Core>
+#include <boost/multi_array.hpp>
 
 //#include "tuple_tools.hpp" // only for debug
 
+#include "allocator.hpp"
+
 namespace gftools { 
 
+template <typename ValueType, size_t N, typename BoostContainerType>
+struct container_base;
+
+template <typename ValueType, size_t N, typename Allocator>
+struct container;
+
 /** eval_expression is an unary tree, representing operator[] of a multidimensional object V, 
   * which has a []...[] method of depth N. The evaluation takes place in 3 walks (forward-back-forward) in the tree,
   * using operator[], apply and get methods. operator[] returns a child eval_expression of depth D=N-1. 
@@ -66,4 +79,86 @@ template <typename V, typename VType, size_t N> struct eval_expression<V,VType,1
     V v_;
 };
 
+/** flat_eval_expression is an eval_expression over the flat memory of a container of rank N : 
+  * it is the result of a chain of operator[] of container_base, with D indices still to be given.
+  * Each operator[] only adds index*stride to the flat offset (no sub-arrays are constructed) 
+  * and the last one loads the value at the collected offset. 
+  * When the chain is not completed the expression behaves as a view of the remaining rank-D block (see view()),
+  * it has the same lifetime as the indexed container (like boost::sub_array).
+  */
+template <typename ValueType, size_t N, size_t D> struct flat_eval_expression
+{
+    static_assert(D>=1 && D<N, "flat_eval_expression should have 1<=D<N");
+    /// rank of the remaining block
+    constexpr static size_t N_ = D;
+    /// typedef for stored values
+    typedef ValueType value_type;
+    /// typedef for a view of the remaining block
+    typedef container_base<ValueType, D, boost::multi_array_ref<ValueType, D>> view_type;
+    /// typedef for a (signed) stride of the container
+    typedef boost::multi_array_types::index index;
+    /// typedef for a result of operator[]
+    typedef typename std::conditional<D==1, ValueType&, flat_eval_expression<ValueType,N,D-1>>::type under_type;
+
+    /// Construct from data, strides and shape of a container of rank N and an offset of the block.
+    flat_eval_expression(ValueType* origin, const index* strides, const size_t* shape, index offset):
+        origin_(origin),strides_(strides),shape_(shape),offset_(offset){}
+
+    /// Add an index to the offset and return an expression of depth D-1 
+    template <size_t M = D>
+        typename std::enable_if<(M>1), under_type>::type operator[](size_t i) const
+            { return under_type(origin_, strides_, shape_, offset_ + index(i)*strides_[N-D]); }
+    /// Load the value at the collected offset
+    template <size_t M = D>
+        typename std::enable_if<(M==1), under_type>::type operator[](size_t i) const
+            { return origin_[offset_ + index(i)*strides_[N-1]]; }
+
+    // Container interface of the remaining block
+    /// returns a view of the remaining block 
+    view_type view() const { return view_type(boost::multi_array_ref<ValueType, D>(data(), shape())); }
+    operator view_type() const { return view(); }
+    /// returns a pointer to the first element of the block
+    ValueType* data() const { return origin_ + offset_; }
+    /// returns the shape of the block
+    std::array<size_t,D> shape() const { std::array<size_t,D> out; for (size_t i=0; i<D; i++) out[i] = shape_[N-D+i]; return out; }
+    /// returns the total size of the block
+    int size() const { int out = 1; for (size_t i=N-D; i<N; i++) out*=shape_[i]; return out; }
+    /// Sum of all values in the block
+    ValueType sum() const { return view().sum(); }
+    /// returns the squared norm difference with a container
+    template <typename C> double diff(const C& r, bool norm = true) const { return view().diff(r, norm); }
+    /// conjugate copy
+    container<ValueType,D> conj() const { return view().conj(); }
+    /// copy into a matrix (2d only) 
+    template<size_t M = D, typename U = typename std::enable_if<M==2>::type>
+        Eigen::Matrix<ValueType,Eigen::Dynamic,Eigen::Dynamic,Eigen::RowMajor> as_matrix() const { return view().as_matrix(); }
+    /// copy into a diagonal matrix
+    Eigen::Matrix<ValueType,Eigen::Dynamic,Eigen::Dynamic,Eigen::RowMajor> as_diagonal_matrix() const { return view().as_diagonal_matrix(); }
+    /// copy flattened block into a vector
+    Eigen::Matrix<ValueType,Eigen::Dynamic,1> as_vector() const { return view().as_vector(); }
+
+    // Assignments write to the block of the container
+    /// copy values from another block
+    flat_eval_expression const& operator=(const flat_eval_expression& rhs) const { view_type v(view()); v = rhs.view(); return *this; }
+    /// assign a number, a container or an expression
+    template <typename R> flat_eval_expression const& operator=(const R& rhs) const { view_type v(view()); v = rhs; return *this; }
+    template <typename R> flat_eval_expression const& operator+=(const R& rhs) const { view_type v(view()); v += rhs; return *this; }
+    template <typename R> flat_eval_expression const& operator-=(const R& rhs) const { view_type v(view()); v -= rhs; return *this; }
+    template <typename R> flat_eval_expression const& operator*=(const R& rhs) const { view_type v(view()); v *= rhs; return *this; }
+    template <typename R> flat_eval_expression const& operator/=(const R& rhs) const { view_type v(view()); v /= rhs; return *this; }
+
+    /// Make the object streamable.
+    friend std::ostream& operator<<(std::ostream& lhs, const flat_eval_expression& in) { return lhs << in.view(); }
+
+protected:
+    /// pointer to the first element of the container
+    ValueType* origin_;
+    /// strides of the container
+    const index* strides_;
+    /// shape of the container
+    const size_t* shape_;
+    /// flat offset of the block, collected from operator[] calls
+    index offset_;
 };
+
+} // end of namespace gftools
@@ -1,92 +1,544 @@
-#pragma once 
+#pragma once
+
+/// \file : fft.hpp
+/// Fast Fourier transforms of containers and grid_objects via FFTW (http://www.fftw.org)
+
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <functional>
+#include <cstdio>
+#include <map>
+#include <mutex>
+#include <numeric>
+#include <tuple>
+#include <string>
+#include <vector>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/file.h>
+#include <unistd.h>
+#define GFTOOLS_FFT_FILE_LOCK
+#endif
 
 #include <gftools/container.hpp>
+#include <gftools/exceptions.hpp>
+#include <gftools/kmesh.hpp>
+#include <gftools/grid_object.hpp>
+#include <gftools/fft_kernels.hpp>
+#include <gftools/parallel.hpp>
 #include <fftw3.h>
 
 namespace gftools {
 
-template <size_t D, typename BC, typename std::enable_if<D==1, bool>::type=0> 
-container<complex_type,D> run_fft (const container_base<complex_type,D,BC> &in, int direction)
-{
-    container<complex_type,D> out(in);
-    fftw_plan p;
-    std::array<size_t,1> shape = {{ out.shape()[0] }};
-    p = fftw_plan_dft_1d(shape[0], 
-                         reinterpret_cast<fftw_complex*>(out.data()),
-                         reinterpret_cast<fftw_complex*>(out.data()),
-                         direction, FFTW_ESTIMATE); 
-    real_type norm=1.0*shape[0];
-    fftw_execute(p);
-    if (direction == FFTW_BACKWARD) out/=norm;
-    fftw_destroy_plan(p);
-    fftw_cleanup();
+/// Rigor of the FFTW planner, that is used to create new plans. Stronger rigor means slower planning and faster transforms.
+enum class fft_rigor : unsigned { estimate = FFTW_ESTIMATE, measure = FFTW_MEASURE, patient = FFTW_PATIENT, exhaustive = FFTW_EXHAUSTIVE };
+
+/** fft_plan_cache is a process-wide cache of FFTW plans.
+ * A plan is created once for each layout of the transform (lengths and strides of the transformed and of the batched dimensions),
+ * direction, planner rigor, in-place-ness and alignment of the data, and is then reused with fftw_execute_dft for any arrays
+ * with the same layout. Planning is serialized with a mutex, since the FFTW planner is not thread-safe; execution of cached
+ * plans is. Plans are destroyed (and fftw_cleanup is called) only by clear() and at exit.
+ * When GFTOOLS_FFTW_THREADS is defined (and fftw3_threads or fftw3_omp is linked), plans are made for set_threads() threads,
+ * but, with a parallel backend, for no more than parallel::num_threads(). FFTW runs them itself, not on the pool of parallel.hpp.
+ * FFTW wisdom can be kept in a file (see set_wisdom_file), so that measured plans are planned once for all runs.
+ * With set_small_kernels(true) transforms, where every transformed length is 1, 2, 4, 8 or 16, are done by run_fft with 
+ * fft_kernel and bypass FFTW. It is off by default, since cached FFTW plans are faster for all these sizes 
+ * (see benchmark/fft_bench.cpp); run_fft_fixed is the fast path for known small sizes.
+ */
+class fft_plan_cache {
+public:
+    /// returns the instance of the cache
+    static fft_plan_cache& instance() { static fft_plan_cache cache; return cache; }
+
+    /// returns a plan for a transform of given dims, batched over howmany_dims. The plan can be executed with fftw_execute_dft on in and out.
+    fftw_plan get(std::vector<fftw_iodim> const& dims, std::vector<fftw_iodim> const& howmany_dims,
+                  fftw_complex* in, fftw_complex* out, int direction)
+        { return this->get_(kind::c2c, dims, howmany_dims, in, out, direction); }
+    /// returns a plan for a real to complex (forward) transform. dims are the logical (real) dims.
+    fftw_plan get_r2c(std::vector<fftw_iodim> const& dims, std::vector<fftw_iodim> const& howmany_dims, real_type* in, fftw_complex* out)
+        { return this->get_(kind::r2c, dims, howmany_dims, in, out, FFTW_FORWARD); }
+    /// returns a plan for a complex to real (backward) transform. dims are the logical (real) dims.
+    fftw_plan get_c2r(std::vector<fftw_iodim> const& dims, std::vector<fftw_iodim> const& howmany_dims, fftw_complex* in, real_type* out)
+        { return this->get_(kind::c2r, dims, howmany_dims, in, out, FFTW_BACKWARD); }
+    /// transform in to out with a cached plan
+    void execute(std::vector<fftw_iodim> const& dims, std::vector<fftw_iodim> const& howmany_dims,
+                 fftw_complex* in, fftw_complex* out, int direction)
+        { fftw_execute_dft(this->get(dims, howmany_dims, in, out, direction), in, out); }
+    /// real to complex transform of in to out with a cached plan
+    void execute_r2c(std::vector<fftw_iodim> const& dims, std::vector<fftw_iodim> const& howmany_dims, real_type* in, fftw_complex* out)
+        { fftw_execute_dft_r2c(this->get_r2c(dims, howmany_dims, in, out), in, out); }
+    /// complex to real transform of in to out with a cached plan (in is destroyed)
+    void execute_c2r(std::vector<fftw_iodim> const& dims, std::vector<fftw_iodim> const& howmany_dims, fftw_complex* in, real_type* out)
+        { fftw_execute_dft_c2r(this->get_c2r(dims, howmany_dims, in, out), in, out); }
+
+    /// set the rigor of the planner for new plans
+    void set_rigor(fft_rigor r) { std::lock_guard<std::mutex> lock(mutex_); rigor_ = r; }
+    /// returns the rigor of the planner
+    fft_rigor rigor() const { return rigor_; }
+    /// set the number of threads, used by new plans (ignored without GFTOOLS_FFTW_THREADS). 
+    /// With a parallel backend new plans use at most parallel::num_threads() threads, and 1 thread in tasks of parallel loops 
+    /// (see parallel.hpp), so that the threads aren't oversubscribed.
+    void set_threads(int n);
+    /// returns the number of threads, set by set_threads
+    int threads() const { return threads_; }
+    /// returns the number of threads of a plan, made now in this thread (threads() limited as described in set_threads)
+    int plan_threads() const;
+    /// use or not (default) fft_kernel instead of FFTW in run_fft for small lengths (1, 2, 4, 8, 16)
+    void set_small_kernels(bool use) { small_kernels_ = use; }
+    /// returns true if run_fft uses fft_kernel for small lengths
+    bool small_kernels() const { return small_kernels_; }
+    /** Set the file for FFTW wisdom : the wisdom is imported from it now and is exported to it each time a new plan is measured.
+     * Access to the file is guarded by a lock file (fname.lock), so that concurrent jobs can share it. An empty name disables it.
+     * The default is the value of the GFTOOLS_FFTW_WISDOM environment variable. Returns true if the wisdom was imported. */
+    bool set_wisdom_file(std::string const& fname);
+    /// returns the name of the file for FFTW wisdom
+    std::string wisdom_file() const { std::lock_guard<std::mutex> lock(mutex_); return wisdom_file_; }
+    /// import FFTW wisdom from a file. Returns true on success.
+    bool import_wisdom(std::string const& fname) { std::lock_guard<std::mutex> lock(mutex_); return import_wisdom_(fname); }
+    /// merge FFTW wisdom with the wisdom in a file and save it there. Returns true on success.
+    bool export_wisdom(std::string const& fname) { std::lock_guard<std::mutex> lock(mutex_); return export_wisdom_(fname); }
+    /// returns the number of cached plans
+    size_t size() const { std::lock_guard<std::mutex> lock(mutex_); return plans_.size(); }
+    /// destroy all plans and release FFTW planner memory. Shouldn't be called while transforms run in other threads.
+    void clear();
+
+    ~fft_plan_cache();
+    fft_plan_cache(fft_plan_cache const&) = delete;
+    fft_plan_cache& operator=(fft_plan_cache const&) = delete;
+
+protected:
+    fft_plan_cache();
+    /// kinds of transforms
+    enum class kind : int { c2c, r2c, c2r };
+    /// (kind, flattened dims, flattened howmany dims, direction, planner flags, threads, in-place, alignment of in, alignment of out)
+    typedef std::tuple<int, std::vector<int>, std::vector<int>, int, unsigned, int, bool, int, int> key_type;
+    fftw_plan get_(kind k, std::vector<fftw_iodim> const& dims, std::vector<fftw_iodim> const& howmany_dims, 
+                   void* in, void* out, int direction);
+    static std::vector<int> flatten_(std::vector<fftw_iodim> const& dims);
+    /// unguarded versions of import_wisdom and export_wisdom
+    bool import_wisdom_(std::string const& fname);
+    bool export_wisdom_(std::string const& fname);
+    /// number of elements, spanned by the dims (is - input strides, os - output strides)
+    static size_t extent_(std::vector<fftw_iodim> const& dims, std::vector<fftw_iodim> const& howmany_dims, bool is);
+
+    mutable std::mutex mutex_;
+    std::map<key_type, fftw_plan> plans_;
+    fft_rigor rigor_ = fft_rigor::estimate;
+    int threads_ = 1;
+    std::atomic<bool> small_kernels_ { false };
+    std::string wisdom_file_;
+};
+
+namespace extra {
+/// fftw dims of a contiguous (c-ordered) array of the given shape
+template <size_t D>
+std::vector<fftw_iodim> fft_dims(std::array<size_t,D> const& shape)
+{
+    std::vector<fftw_iodim> dims(D);
+    int stride = 1;
+    for (int i = D-1; i>=0; --i) {
+        dims[i].n = static_cast<int>(shape[i]);
+        dims[i].is = dims[i].os = stride;
+        stride *= dims[i].n;
+        }
+    return dims;
+}
+
+/// fftw dims of a contiguous (c-ordered) array of the given shape, split into transformed (mask[i] == true) and batched dims
+template <size_t D>
+std::pair<std::vector<fftw_iodim>, std::vector<fftw_iodim>> fft_dims(std::array<size_t,D> const& shape, std::array<bool,D> const& mask)
+{
+    std::vector<fftw_iodim> all = fft_dims(shape), dims, howmany_dims;
+    for (size_t i = 0; i < D; ++i) (mask[i] ? dims : howmany_dims).push_back(all[i]);
+    return std::make_pair(dims, howmany_dims);
+}
+
+/// fftw dims of a real to complex transform of a contiguous real array of the given shape to a contiguous half-complex array
+/// (for complex to real transforms the input and output strides are swapped)
+template <size_t D>
+std::vector<fftw_iodim> fft_r2c_dims(std::array<size_t,D> const& shape, bool c2r = false)
+{
+    std::vector<fftw_iodim> dims(D);
+    int real_stride = 1, half_stride = 1;
+    for (int i = D-1; i>=0; --i) {
+        dims[i].n = static_cast<int>(shape[i]);
+        dims[i].is = c2r ? half_stride : real_stride;
+        dims[i].os = c2r ? real_stride : half_stride;
+        real_stride *= dims[i].n;
+        half_stride *= (i == int(D)-1) ? dims[i].n/2 + 1 : dims[i].n;
+        }
+    return dims;
+}
+
+/// shape of the half-complex transform of a real array of the given shape
+template <size_t D>
+std::array<size_t,D> fft_half_shape(std::array<size_t,D> shape) { shape[D-1] = shape[D-1]/2 + 1; return shape; }
+
+/// normalization of the backward transform over the given dims
+inline real_type fft_norm(std::vector<fftw_iodim> const& dims)
+{
+    real_type norm = 1.0;
+    for (auto const& d : dims) norm *= d.n;
+    return norm;
+}
+
+/// true_type if I is one of Axes
+template <size_t I, size_t... Axes> struct fft_axis_selected : std::false_type {};
+template <size_t I, size_t A, size_t... Axes> 
+struct fft_axis_selected<I,A,Axes...> : std::integral_constant<bool, I==A || fft_axis_selected<I,Axes...>::value> {};
+
+/// true_type if all Axes are less than N
+template <size_t N, size_t... Axes> struct fft_axes_in_range : std::true_type {};
+template <size_t N, size_t A, size_t... Axes> 
+struct fft_axes_in_range<N,A,Axes...> : std::integral_constant<bool, (A<N) && fft_axes_in_range<N,Axes...>::value> {};
+
+/// fft_grid gives the grid, that is reciprocal to the given grid, when Transform is true. Only kmesh grids can be transformed.
+template <bool Transform, typename GridType>
+struct fft_grid {
+    static_assert(!Transform, "Only kmesh grids can be Fourier transformed");
+    static GridType const& get(GridType const& in) { return in; }
+};
+/// reciprocal to a kmesh of n points over 2*PI is the lattice of n sites, i.e. a kmesh of n points over n (and vice versa)
+template <>
+struct fft_grid<true, kmesh> {
+    static kmesh get(kmesh const& in) { return kmesh(in.size(), 2.0 * M_PI * in.size() / in.domain_len()); }
+};
+
+template <size_t... Axes, int... S, typename CT, typename... GridTypes>
+grid_object_ref<complex_type, GridTypes...> 
+    run_fft_(tuple_tools::extra::arg_seq<S...>, grid_object_base<CT, GridTypes...>& in, int direction)
+{
+    constexpr size_t N = sizeof...(GridTypes);
+    const std::array<bool,N> mask = {{ fft_axis_selected<S, Axes...>::value... }};
+    run_fft_inplace(in.data(), direction, mask);
+    in.invalidate_interpolation();
+    std::tuple<GridTypes...> grids(fft_grid<fft_axis_selected<S, Axes...>::value, GridTypes>::get(std::get<S>(in.grids()))...);
+    return grid_object_ref<complex_type, GridTypes...>(grids, in.data());
+}
+} // end of namespace extra
+
+/** Fourier transform of a container of any rank along the axes with mask[i] == true (all axes by default), 
+ * batched over the other axes. The transform is done in place (no copies are made). 
+ * The container should be contiguous (a container or a container_ref). Backward transform is normalized. */
+template <size_t D, typename BC>
+void run_fft_inplace (container_base<complex_type,D,BC> &in, int direction, 
+                      std::array<bool,D> const& mask = tuple_tools::repeater<bool,D>::get_array(true))
+{
+    auto dims = extra::fft_dims(in.shape(), mask);
+    fft_plan_cache& cache = fft_plan_cache::instance();
+    if (!cache.small_kernels() || !fft_small_transform(in.data(), dims.first, dims.second, direction)) {
+        fftw_complex* data = reinterpret_cast<fftw_complex*>(in.data());
+        cache.execute(dims.first, dims.second, data, data, direction);
+        }
+    if (direction == FFTW_BACKWARD) in/=extra::fft_norm(dims.first);
+}
+
+/** Fourier transform of a container of any rank along the axes with mask[i] == true (all axes by default) into a 
+ * caller-provided container of the same shape. Both containers should be contiguous. The input is not modified. 
+ * Backward transform is normalized. */
+template <size_t D, typename BC1, typename BC2>
+void run_fft (const container_base<complex_type,D,BC1> &in, container_base<complex_type,D,BC2> &out, int direction, 
+              std::array<bool,D> const& mask = tuple_tools::repeater<bool,D>::get_array(true))
+{
+    if (in.shape() != out.shape()) throw ex_generic("run_fft : shapes of input and output mismatch");
+    auto dims = extra::fft_dims(in.shape(), mask);
+    fft_plan_cache& cache = fft_plan_cache::instance();
+    if (cache.small_kernels() && extra::fft_small_lengths(dims.first)) {
+        std::copy(in.data(), in.data() + in.size(), out.data());
+        fft_small_transform(out.data(), dims.first, dims.second, direction);
+        }
+    else {
+        // out-of-place complex transforms of FFTW preserve the input
+        fftw_complex* in_data = reinterpret_cast<fftw_complex*>(const_cast<complex_type*>(in.data()));
+        fftw_complex* out_data = reinterpret_cast<fftw_complex*>(out.data());
+        cache.execute(dims.first, dims.second, in_data, out_data, direction);
+        }
+    if (direction == FFTW_BACKWARD) out/=extra::fft_norm(dims.first);
+}
+
+/** Fourier transform of a container of any rank along the axes with mask[i] == true (all axes by default). 
+ * Returns a new container, allocated with Allocator. Backward transform is normalized. 
+ * Example : run_fft(chi, FFTW_FORWARD, {{false, false, true, true, true}}) transforms chi(w,w',kx,ky,kz) to chi(w,w',x,y,z). */
+template <typename Allocator = aligned_allocator<complex_type>, size_t D, typename BC>
+container<complex_type,D,Allocator> run_fft (const container_base<complex_type,D,BC> &in, int direction, 
+                                   std::array<bool,D> const& mask = tuple_tools::repeater<bool,D>::get_array(true))
+{
+    container<complex_type,D,Allocator> out(in.shape());
+    run_fft(in, out, direction, mask);
     return out;
 }
 
+/** Fourier transform of a grid_object along the kmesh grids with indices Axes..., batched over all other grids.
+ * The data of in is transformed in place (backward transform is normalized). Returns a view of the transformed data 
+ * on the reciprocal grids : a kmesh of n points over 2*PI becomes a lattice of n sites (a kmesh over n) and vice versa.
+ * Example : run_fft<1,2>(g_wk, FFTW_BACKWARD) transforms g(w,kx,ky) to g(w,x,y).
+ */
+template <size_t... Axes, typename CT, typename... GridTypes>
+grid_object_ref<complex_type, GridTypes...> 
+    run_fft(grid_object_base<CT, GridTypes...>& in, int direction)
+{
+    static_assert(sizeof...(Axes) > 0, "No grids to transform");
+    static_assert(extra::fft_axes_in_range<sizeof...(GridTypes), Axes...>::value, "Axis index is out of range");
+    static_assert(std::is_same<typename CT::value_type, complex_type>::value, "Only complex grid_objects can be Fourier transformed");
+    return extra::run_fft_<Axes...>(typename tuple_tools::extra::index_gen<sizeof...(GridTypes)>::type(), in, direction);
+}
 
-template <size_t D, typename BC, typename std::enable_if<D==2, bool>::type=0> 
-container<complex_type,D> run_fft (const container_base<complex_type,D,BC> &in, int direction)
+/** Real to complex forward Fourier transform of a contiguous real container along all axes. 
+ * The transform of real data is hermitian, X(k) = conj(X(-k)), so only the non-negative half of the last axis is stored : 
+ * the result has the shape n_0 x ... x (n_{D-1}/2+1). Use fft_expand_hermitian to obtain the full array. 
+ * The results of run_fft_r2c, run_fft_c2r and fft_expand_hermitian are allocated with Allocator (see allocator.hpp).
+ */
+template <typename Allocator = aligned_allocator<complex_type>, size_t D, typename BC>
+container<complex_type,D,Allocator> run_fft_r2c (const container_base<real_type,D,BC> &in)
 {
-    container<complex_type,D> out(in);
-    fftw_plan p;
-    std::array<size_t,2> shape = {{ out.shape()[0], out.shape()[1] }};
-    p = fftw_plan_dft_2d(shape[0], shape[1],  
-                         reinterpret_cast<fftw_complex*>(out.data()),
-                         reinterpret_cast<fftw_complex*>(out.data()),
-                         direction, FFTW_ESTIMATE); 
-    real_type norm=1.0*shape[0]*shape[1];
-    fftw_execute(p);
-    if (direction == FFTW_BACKWARD) out/=norm;
-    fftw_destroy_plan(p);
-    fftw_cleanup();
+    container<complex_type,D,Allocator> out(extra::fft_half_shape(in.shape()));
+    // out-of-place real to complex transforms of FFTW preserve the input
+    fft_plan_cache::instance().execute_r2c(extra::fft_r2c_dims(in.shape()), std::vector<fftw_iodim>(), 
+        const_cast<real_type*>(in.data()), reinterpret_cast<fftw_complex*>(out.data()));
     return out;
 }
 
-template <size_t D, typename BC, typename std::enable_if<D==3, bool>::type=0> 
-container<complex_type,D> run_fft (const container_base<complex_type,D,BC> &in, int direction)
-{
-    container<complex_type,D> out(in);
-    fftw_plan p;
-    std::array<size_t,3> shape = {{ out.shape()[0], out.shape()[1], out.shape()[2] }};
-    p = fftw_plan_dft_3d(shape[0], shape[1], shape[2], 
-                         reinterpret_cast<fftw_complex*>(out.data()),
-                         reinterpret_cast<fftw_complex*>(out.data()),
-                         direction, FFTW_ESTIMATE); 
-    real_type norm=1.0*shape[0]*shape[1]*shape[2];
-    fftw_execute(p);
-    if (direction == FFTW_BACKWARD) out/=norm;
-    fftw_destroy_plan(p);
-    fftw_cleanup();
+/** Complex to real (normalized) backward Fourier transform of a half-complex container (see run_fft_r2c) 
+ * into a real container with n_last points along the last axis. */
+template <typename Allocator = aligned_allocator<real_type>, size_t D, typename BC>
+container<real_type,D,Allocator> run_fft_c2r (const container_base<complex_type,D,BC> &in, size_t n_last)
+{
+    std::array<size_t,D> shape = in.shape();
+    shape[D-1] = n_last;
+    if (extra::fft_half_shape(shape) != in.shape()) throw ex_generic("run_fft_c2r : wrong shape of the half-complex input");
+    // complex to real transforms of FFTW destroy the input
+    container<complex_type,D> half(in);
+    container<real_type,D,Allocator> out(shape);
+    fft_plan_cache::instance().execute_c2r(extra::fft_r2c_dims(shape, true), std::vector<fftw_iodim>(), 
+        reinterpret_cast<fftw_complex*>(half.data()), out.data());
+    out /= real_type(out.size());
     return out;
 }
 
-template <size_t D, typename BC, typename std::enable_if<D==4, bool>::type=0> 
-container<complex_type,D> run_fft (const container_base<complex_type,D,BC> &in, int direction)
-{
-    container<complex_type,D> out(in);
-    fftw_plan p;
-    const std::array<int,4> shape = {{ static_cast<int>(out.shape()[0]), static_cast<int>(out.shape()[1]),
-                                       static_cast<int>(out.shape()[2]), static_cast<int>(out.shape()[3])
-                                    }};
-    p = fftw_plan_dft(4, shape.data(),
-                         reinterpret_cast<fftw_complex*>(out.data()),
-                         reinterpret_cast<fftw_complex*>(out.data()),
-                         direction, FFTW_ESTIMATE); 
-    real_type norm=1.0*shape[0]*shape[1]*shape[2]*shape[3];
-    fftw_execute(p);
-    if (direction == FFTW_BACKWARD) out/=norm;
-    fftw_destroy_plan(p);
-    fftw_cleanup();
+/** Expands a half-complex transform of a real array with n_last points along the last axis (see run_fft_r2c) 
+ * to the full complex array, using X(k) = conj(X(-k)). */
+template <typename Allocator = aligned_allocator<complex_type>, size_t D, typename BC>
+container<complex_type,D,Allocator> fft_expand_hermitian (const container_base<complex_type,D,BC> &half, size_t n_last)
+{
+    std::array<size_t,D> shape = half.shape(), half_shape = half.shape();
+    shape[D-1] = n_last;
+    if (extra::fft_half_shape(shape) != half_shape) throw ex_generic("fft_expand_hermitian : wrong shape of the half-complex input");
+    container<complex_type,D,Allocator> out(shape);
+    const complex_type* src = half.data();
+    complex_type* dst = out.data();
+    for (int i = 0; i < out.size(); ++i) {
+        std::array<size_t,D> index = extra::enumerate_indices_(i, shape);
+        bool stored = (index[D-1] < half_shape[D-1]);
+        if (!stored) for (size_t d = 0; d < D; ++d) index[d] = (shape[d] - index[d]) % shape[d];
+        size_t offset = 0;
+        for (size_t d = 0; d < D; ++d) offset = offset * half_shape[d] + index[d];
+        dst[i] = stored ? src[offset] : std::conj(src[offset]);
+        }
     return out;
 }
 
+namespace extra {
+template <int... S, typename... GridTypes>
+std::tuple<GridTypes...> fft_reciprocal_grids_(tuple_tools::extra::arg_seq<S...>, std::tuple<GridTypes...> const& grids)
+    { return std::tuple<GridTypes...>(fft_grid<true, GridTypes>::get(std::get<S>(grids))...); }
+} // end of namespace extra
 
+/** Fourier transform of a real grid_object along all of its grids (which should all be kmesh) via a real to complex transform.
+ * Returns the full complex object on the reciprocal grids. Backward transform is normalized. 
+ * Example : eps(kx,ky) -> eps(x,y) is run_fft_r2c(eps_k, FFTW_BACKWARD).
+ */
+template <typename CT, typename... GridTypes>
+grid_object<complex_type, GridTypes...> run_fft_r2c (const grid_object_base<CT, GridTypes...> &in, int direction)
+{
+    static_assert(std::is_same<typename CT::value_type, real_type>::value, "run_fft_r2c requires a real grid_object");
+    constexpr size_t N = sizeof...(GridTypes);
+    container<complex_type,N> out = fft_expand_hermitian(run_fft_r2c(in.data()), in.data().shape()[N-1]);
+    // backward transform of real data is a conjugate of the forward one
+    if (direction == FFTW_BACKWARD) { out = out.conj(); out /= real_type(out.size()); }
+    return grid_object<complex_type, GridTypes...>(
+        extra::fft_reciprocal_grids_(typename tuple_tools::extra::index_gen<N>::type(), in.grids()), out);
+}
+
+/// Momentum conventions of fft_convolve : k+q (particle-hole) or q-k (particle-particle)
+enum class fft_channel { particle_hole, particle_particle };
+
+/** Momentum sum of a product of two grid_objects, evaluated for all transferred momenta q at once :
+ *   C(q) = 1/N_k \sum_k A(k) B(k+q) (particle-hole) or C(q) = 1/N_k \sum_k A(k) B(q-k) (particle-particle),
+ * where k and q run over the kmesh grids with indices Axes... and all other grids are spectators (the product is taken pointwise).
+ * A and B are Fourier transformed to the lattice, multiplied and transformed back, which costs O(N_k log N_k) instead of O(N_k^2)
+ * for every spectator point. Example : the bubble -T \sum_k G(w,k) G(w,k+q) is -T * fft_convolve<1,2>(g_wk, g_wk).
+ */
+template <size_t... Axes, typename CT1, typename CT2, typename... GridTypes>
+grid_object<complex_type, GridTypes...> fft_convolve(
+    const grid_object_base<CT1, GridTypes...>& a, const grid_object_base<CT2, GridTypes...>& b, fft_channel channel = fft_channel::particle_hole)
+{
+    typedef typename grid_object_base<CT1, GridTypes...>::trs trs;
+    if (!trs::is_equal(a.grids(), b.grids())) throw ex_generic("fft_convolve : objects are defined on different grids");
+
+    const std::array<size_t, sizeof...(Axes)> sizes = {{ std::get<Axes>(a.grids()).size()... }};
+    const real_type nk = std::accumulate(sizes.begin(), sizes.end(), real_type(1), std::multiplies<real_type>());
+
+    grid_object<complex_type, GridTypes...> a_r(a), b_r(b);
+    // 1/N_k \sum_k A(k) e^{-ikx} = A(-x) in the particle-hole channel, A(x) in the particle-particle channel
+    if (channel == fft_channel::particle_hole) { run_fft<Axes...>(a_r, FFTW_FORWARD); a_r.data() /= nk; }
+    else run_fft<Axes...>(a_r, FFTW_BACKWARD);
+    run_fft<Axes...>(b_r, FFTW_BACKWARD);
+    a_r.data() *= b_r.data();
+    run_fft<Axes...>(a_r, FFTW_FORWARD);
+    // a_r carries the tail of a, which is not a tail of the convolution
+    a_r.set_tail(tools::fun_traits<typename grid_object<complex_type, GridTypes...>::function_type>::constant(0.0));
+    return a_r;
+}
+
+//
+// fft_plan_cache
+//
+
+inline fft_plan_cache::fft_plan_cache()
+{
+#ifdef GFTOOLS_FFTW_THREADS
+    if (!fftw_init_threads()) throw ex_generic("fft_plan_cache : can't initialize FFTW threads");
+#endif
+    const char* fname = std::getenv("GFTOOLS_FFTW_WISDOM");
+    if (fname) { wisdom_file_ = fname; import_wisdom_(wisdom_file_); }
+}
+
+inline fft_plan_cache::~fft_plan_cache()
+{
+    clear();
+#ifdef GFTOOLS_FFTW_THREADS
+    fftw_cleanup_threads();
+#endif
+}
+
+inline void fft_plan_cache::set_threads(int n)
+{
+    if (n < 1) throw ex_generic("fft_plan_cache : number of threads should be positive");
+#ifdef GFTOOLS_FFTW_THREADS
+    std::lock_guard<std::mutex> lock(mutex_);
+    threads_ = n;
+#endif
+}
+
+inline int fft_plan_cache::plan_threads() const
+{
+    if (parallel::in_task()) return 1;
+    return parallel::enabled() ? std::min(threads_, parallel::num_threads()) : threads_;
+}
+
+inline bool fft_plan_cache::set_wisdom_file(std::string const& fname)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    wisdom_file_ = fname;
+    return !fname.empty() && import_wisdom_(fname);
+}
+
+namespace extra {
+/// An advisory lock of a file (fname.lock) for the lifetime of the object. Does nothing on systems without flock.
+struct fft_file_lock {
+    fft_file_lock(std::string const& fname, bool exclusive) {
+#ifdef GFTOOLS_FFT_FILE_LOCK
+        fd_ = ::open((fname + ".lock").c_str(), O_RDWR | O_CREAT, 0666);
+        if (fd_ >= 0 && ::flock(fd_, exclusive ? LOCK_EX : LOCK_SH) != 0) { ::close(fd_); fd_ = -1; }
+#endif
+    }
+    ~fft_file_lock() {
+#ifdef GFTOOLS_FFT_FILE_LOCK
+        if (fd_ >= 0) { ::flock(fd_, LOCK_UN); ::close(fd_); }
+#endif
+    }
+    fft_file_lock(fft_file_lock const&) = delete;
+    fft_file_lock& operator=(fft_file_lock const&) = delete;
+    int fd_ = -1;
+};
+} // end of namespace extra
+
+inline bool fft_plan_cache::import_wisdom_(std::string const& fname)
+{
+    extra::fft_file_lock lock(fname, false);
+    return fftw_import_wisdom_from_filename(fname.c_str());
+}
+
+inline bool fft_plan_cache::export_wisdom_(std::string const& fname)
+{
+    extra::fft_file_lock lock(fname, true);
+    // keep the wisdom, saved by other jobs
+    fftw_import_wisdom_from_filename(fname.c_str());
+    // write to a temporary file and move it, so that the file is never seen half-written
+    std::string tmp_name = fname + ".tmp";
+    if (!fftw_export_wisdom_to_filename(tmp_name.c_str())) return false;
+    return std::rename(tmp_name.c_str(), fname.c_str()) == 0;
+}
+
+inline std::vector<int> fft_plan_cache::flatten_(std::vector<fftw_iodim> const& dims)
+{
+    std::vector<int> out;
+    out.reserve(3*dims.size());
+    for (auto const& d : dims) { out.push_back(d.n); out.push_back(d.is); out.push_back(d.os); }
+    return out;
+}
+
+inline size_t fft_plan_cache::extent_(std::vector<fftw_iodim> const& dims, std::vector<fftw_iodim> const& howmany_dims, bool is)
+{
+    size_t out = 1;
+    for (auto const& d : dims) out += size_t(d.n - 1) * std::abs(is ? d.is : d.os);
+    for (auto const& d : howmany_dims) out += size_t(d.n - 1) * std::abs(is ? d.is : d.os);
+    return out;
+}
 
-template <size_t D, typename BC, typename std::enable_if<D>=5, bool>::type=0> 
-container<complex_type,D> run_fft (const container_base<complex_type,D,BC> &in, int direction)
+inline fftw_plan fft_plan_cache::get_(kind k, std::vector<fftw_iodim> const& dims, std::vector<fftw_iodim> const& howmany_dims,
+                                      void* in, void* out, int direction)
 {
-    ERROR("No FFT defined for D="<<D);
-    return in; 
+    std::lock_guard<std::mutex> lock(mutex_);
+    const unsigned flags = static_cast<unsigned>(rigor_);
+    const bool in_place = (in == out);
+    const int in_align = fftw_alignment_of(static_cast<double*>(in));
+    const int out_align = fftw_alignment_of(static_cast<double*>(out));
+    const int threads = plan_threads();
+    key_type key(int(k), flatten_(dims), flatten_(howmany_dims), direction, flags, threads, in_place, in_align, out_align);
+
+    auto it = plans_.find(key);
+    if (it != plans_.end()) return it->second;
+
+#ifdef GFTOOLS_FFTW_THREADS
+    fftw_plan_with_nthreads(threads);
+#endif
+    char* scratch = nullptr;
+    if (rigor_ != fft_rigor::estimate) {
+        // stronger planners overwrite the arrays - plan on scratch arrays with the same alignment
+        const size_t in_bytes = extent_(dims, howmany_dims, true) * (k == kind::r2c ? sizeof(real_type) : sizeof(fftw_complex));
+        const size_t out_bytes = extent_(dims, howmany_dims, false) * (k == kind::c2r ? sizeof(real_type) : sizeof(fftw_complex));
+        const size_t pad = 64; // larger than any simd alignment of FFTW
+        scratch = static_cast<char*>(fftw_malloc((in_place ? std::max(in_bytes, out_bytes) : in_bytes + out_bytes) + 3*pad));
+        if (!scratch) throw ex_generic("fft_plan_cache : can't allocate scratch memory for planning");
+        in = scratch + in_align;
+        out = in_place ? in : scratch + ((in_align + in_bytes) / pad + 1) * pad + out_align;
+        }
+    const int rank = dims.size(), howmany_rank = howmany_dims.size();
+    fftw_plan p = nullptr;
+    switch (k) {
+        case kind::c2c: p = fftw_plan_guru_dft(rank, dims.data(), howmany_rank, howmany_dims.data(), 
+                                static_cast<fftw_complex*>(in), static_cast<fftw_complex*>(out), direction, flags); break;
+        case kind::r2c: p = fftw_plan_guru_dft_r2c(rank, dims.data(), howmany_rank, howmany_dims.data(), 
+                                static_cast<real_type*>(in), static_cast<fftw_complex*>(out), flags); break;
+        case kind::c2r: p = fftw_plan_guru_dft_c2r(rank, dims.data(), howmany_rank, howmany_dims.data(), 
+                                static_cast<fftw_complex*>(in), static_cast<real_type*>(out), flags); break;
+        }
+    if (scratch) fftw_free(scratch);
+    if (!p) throw ex_generic("fft_plan_cache : FFTW failed to create a plan");
+    plans_.emplace(key, p);
+    if (rigor_ != fft_rigor::estimate && !wisdom_file_.empty()) export_wisdom_(wisdom_file_);
+    return p;
+}
+
+inline void fft_plan_cache::clear()
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (auto& x : plans_) fftw_destroy_plan(x.second);
+    plans_.clear();
+    fftw_cleanup();
 }
 
 } // end of namespace gftools
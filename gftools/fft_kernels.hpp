@@ -0,0 +1,247 @@
+#pragma once
+
+/// \file : fft_kernels.hpp
+/// Small fixed-size fast Fourier transforms for tiny kmeshes (2, 4, 8, 16 points per axis).
+/// The transforms are written out as straight-line butterflies with literal twiddle factors : N = 8 is split into 2 x 4 and 
+/// N = 16 into 4 x 4 points. The kernels don't depend on FFTW. run_fft_fixed applies them with compile-time extents and 
+/// strides; fft.hpp can use them in run_fft for small lengths (see fft_plan_cache::set_small_kernels).
+
+#include <array>
+#include <cmath>
+#include <cstddef>
+#include <vector>
+
+#include "container.hpp"
+#include "exceptions.hpp"
+#include "parallel.hpp"
+
+namespace gftools {
+
+namespace extra {
+/// complex multiplication without the inf/nan recovery of std::complex operator*
+inline complex_type fft_mul(complex_type const& a, complex_type const& b)
+    { return complex_type(a.real()*b.real() - a.imag()*b.imag(), a.real()*b.imag() + a.imag()*b.real()); }
+/// z * exp(S * 2 PI i m / 16), S = -1 (forward) or +1 (backward)
+template <int S>
+inline complex_type fft_twiddle16(complex_type const& z, int m)
+{
+    // cos(2 PI m / 16), sin(2 PI m / 16) : constant tables, that are folded into the butterflies, when m is known
+    static const double c[16] = { 1., 0.92387953251128675613, 0.70710678118654752440, 0.38268343236508977173, 
+        0., -0.38268343236508977173, -0.70710678118654752440, -0.92387953251128675613, 
+        -1., -0.92387953251128675613, -0.70710678118654752440, -0.38268343236508977173, 
+        0., 0.38268343236508977173, 0.70710678118654752440, 0.92387953251128675613 };
+    return fft_mul(z, complex_type(c[m % 16], S * c[(m + 12) % 16]));
+}
+/// 4-point butterfly of a0, a1, a2, a3 in place
+template <int S>
+inline void fft_butterfly4(complex_type& a0, complex_type& a1, complex_type& a2, complex_type& a3)
+{
+    complex_type s02 = a0 + a2, d02 = a0 - a2, s13 = a1 + a3, d13 = a1 - a3;
+    // S * i * (a1 - a3)
+    complex_type id13(-S * d13.imag(), S * d13.real());
+    a0 = s02 + s13;
+    a1 = d02 + id13;
+    a2 = s02 - s13;
+    a3 = d02 - id13;
+}
+} // end of namespace extra
+
+/** fft_kernel<N> is an unnormalized discrete Fourier transform of N contiguous points with N known at compile time :
+ * X_k = \sum_n x_n exp(sign * 2 PI i k n / N), sign = -1 (FFTW_FORWARD) or +1 (FFTW_BACKWARD).
+ * run<S> transforms with the sign S known at compile time, transform dispatches a runtime sign to it.
+ * Defined for N = 1, 2, 4, 8 and 16.
+ */
+template <size_t N>
+struct fft_kernel;
+
+template <>
+struct fft_kernel<1> {
+    template <int S> static void run(complex_type*) {}
+    static void transform(complex_type*, int) {}
+};
+
+template <>
+struct fft_kernel<2> {
+    template <int S> static void run(complex_type* x)
+    {
+        complex_type a = x[0];
+        x[0] = a + x[1];
+        x[1] = a - x[1];
+    }
+    static void transform(complex_type* x, int) { run<1>(x); }
+};
+
+template <>
+struct fft_kernel<4> {
+    template <int S> static void run(complex_type* x) { extra::fft_butterfly4<S>(x[0], x[1], x[2], x[3]); }
+    static void transform(complex_type* x, int sign) { if (sign > 0) run<1>(x); else run<-1>(x); }
+};
+
+template <>
+struct fft_kernel<8> {
+    /// 2 x 4 points : X[k1 + 4 k2] = \sum_n2 w^(n2 (k1 + 4 k2)) Y_n2[k1], Y_n2 = 4-point transform of x[2 n1 + n2]
+    template <int S> static void run(complex_type* x)
+    {
+        complex_type e0 = x[0], e1 = x[2], e2 = x[4], e3 = x[6], o0 = x[1], o1 = x[3], o2 = x[5], o3 = x[7];
+        extra::fft_butterfly4<S>(e0, e1, e2, e3);
+        extra::fft_butterfly4<S>(o0, o1, o2, o3);
+        o1 = extra::fft_twiddle16<S>(o1, 2);
+        o2 = complex_type(-S * o2.imag(), S * o2.real());
+        o3 = extra::fft_twiddle16<S>(o3, 6);
+        x[0] = e0 + o0; x[4] = e0 - o0;
+        x[1] = e1 + o1; x[5] = e1 - o1;
+        x[2] = e2 + o2; x[6] = e2 - o2;
+        x[3] = e3 + o3; x[7] = e3 - o3;
+    }
+    static void transform(complex_type* x, int sign) { if (sign > 0) run<1>(x); else run<-1>(x); }
+};
+
+template <>
+struct fft_kernel<16> {
+    /// 4 x 4 points : 4-point transforms of x[4 n1 + n2] for each n2, twiddles w^(n2 k1), 4-point transforms over n2
+    template <int S> static void run(complex_type* x)
+    {
+        complex_type y[4][4];
+        for (int n2 = 0; n2 < 4; ++n2) {
+            y[n2][0] = x[n2]; y[n2][1] = x[n2 + 4]; y[n2][2] = x[n2 + 8]; y[n2][3] = x[n2 + 12];
+            extra::fft_butterfly4<S>(y[n2][0], y[n2][1], y[n2][2], y[n2][3]);
+            }
+        for (int n2 = 1; n2 < 4; ++n2)
+            for (int k1 = 1; k1 < 4; ++k1) y[n2][k1] = extra::fft_twiddle16<S>(y[n2][k1], n2 * k1);
+        for (int k1 = 0; k1 < 4; ++k1) {
+            extra::fft_butterfly4<S>(y[0][k1], y[1][k1], y[2][k1], y[3][k1]);
+            x[k1] = y[0][k1]; x[k1 + 4] = y[1][k1]; x[k1 + 8] = y[2][k1]; x[k1 + 12] = y[3][k1];
+            }
+    }
+    static void transform(complex_type* x, int sign) { if (sign > 0) run<1>(x); else run<-1>(x); }
+};
+
+namespace extra {
+/// transform N points, that are stride elements apart, in place with the sign S
+template <size_t N, int S>
+inline void fft_kernel_apply_(complex_type* x, std::ptrdiff_t stride)
+{
+    complex_type buf[N];
+    for (size_t i = 0; i < N; ++i) buf[i] = x[i*stride];
+    fft_kernel<N>::template run<S>(buf);
+    for (size_t i = 0; i < N; ++i) x[i*stride] = buf[i];
+}
+} // end of namespace extra
+
+/// transform N points, that are stride elements apart, in place
+template <size_t N>
+void fft_kernel_apply(complex_type* x, std::ptrdiff_t stride, int sign)
+{
+    if (sign > 0) extra::fft_kernel_apply_<N, 1>(x, stride); 
+    else extra::fft_kernel_apply_<N, -1>(x, stride);
+}
+
+/// A type of a pointer to fft_kernel_apply
+typedef void (*fft_kernel_type)(complex_type*, std::ptrdiff_t, int);
+
+/// returns a kernel for n points (n = 1, 2, 4, 8, 16) or nullptr, if there is none
+inline fft_kernel_type fft_small_kernel(size_t n)
+{
+    switch (n) {
+        case 1: return &fft_kernel_apply<1>;
+        case 2: return &fft_kernel_apply<2>;
+        case 4: return &fft_kernel_apply<4>;
+        case 8: return &fft_kernel_apply<8>;
+        case 16: return &fft_kernel_apply<16>;
+        default: return nullptr;
+        }
+}
+
+namespace extra {
+/// true if there is a small kernel for each of dims
+template <typename Dim>
+bool fft_small_lengths(std::vector<Dim> const& dims)
+{
+    for (auto const& d : dims) if (!fft_small_kernel(d.n)) return false;
+    return true;
+}
+
+/** Applies kernels[a] along the axis dims[a] of a strided array for every a, batched over batch_dims.
+ * Dim is any type with n (length) and is (stride) fields, e.g. fftw_iodim. */
+template <typename Dim>
+void fft_kernels_run(complex_type* data, std::vector<Dim> const& dims, std::vector<fft_kernel_type> const& kernels,
+                     std::vector<Dim> const& batch_dims, int sign)
+{
+    for (size_t a = 0; a < dims.size(); ++a) {
+        // all lines along the axis a : iterate over all other axes
+        std::vector<Dim> others(batch_dims);
+        for (size_t b = 0; b < dims.size(); ++b) if (b != a) others.push_back(dims[b]);
+        size_t nlines = 1;
+        for (auto const& d : others) nlines *= d.n;
+        // the lines are independent : large batches are split into ranges of lines, that are transformed in parallel
+        parallel::for_each_range(nlines, nlines * dims[a].n, [&](size_t l0, size_t l1) {
+            std::vector<int> index(others.size(), 0);
+            std::ptrdiff_t offset = 0;
+            size_t t = l0;
+            for (int d = int(others.size()) - 1; d >= 0; --d) {
+                index[d] = t % others[d].n;
+                t /= others[d].n;
+                offset += std::ptrdiff_t(others[d].is) * index[d];
+                }
+            for (size_t l = l0; l < l1; ++l) {
+                kernels[a](data + offset, dims[a].is, sign);
+                for (int d = int(others.size()) - 1; d >= 0; --d) {
+                    offset += others[d].is;
+                    if (++index[d] < others[d].n) break;
+                    offset -= std::ptrdiff_t(others[d].is) * others[d].n;
+                    index[d] = 0;
+                    }
+                }
+            });
+        }
+}
+} // end of namespace extra
+
+/** In-place unnormalized transform of a strided array with small kernels along dims, batched over batch_dims
+ * (Dim is any type with n and is fields, e.g. fftw_iodim). Does nothing and returns false, if some of dims has no kernel. */
+template <typename Dim>
+bool fft_small_transform(complex_type* data, std::vector<Dim> const& dims, std::vector<Dim> const& batch_dims, int sign)
+{
+    if (!extra::fft_small_lengths(dims)) return false;
+    std::vector<fft_kernel_type> kernels;
+    for (auto const& d : dims) kernels.push_back(fft_small_kernel(d.n));
+    extra::fft_kernels_run(data, dims, kernels, batch_dims, sign);
+    return true;
+}
+
+namespace extra {
+/// product of Ns...
+template <size_t... Ns> struct fft_fixed_size_ { static constexpr size_t value = 1; };
+template <size_t N, size_t... Ns> struct fft_fixed_size_<N, Ns...> { static constexpr size_t value = N * fft_fixed_size_<Ns...>::value; };
+
+/// transforms along the axes N, Ns... of a contiguous array, where Outer is the product of the extents of the preceding axes
+template <size_t Outer, int S, size_t... Ns> struct fft_fixed_axes_ { static void run(complex_type*) {} };
+template <size_t Outer, int S, size_t N, size_t... Ns> 
+struct fft_fixed_axes_<Outer, S, N, Ns...> {
+    static void run(complex_type* x)
+    {
+        constexpr size_t stride = fft_fixed_size_<Ns...>::value;
+        for (size_t o = 0; o < Outer; ++o)
+            for (size_t i = 0; i < stride; ++i) fft_kernel_apply_<N, S>(x + o*N*stride + i, stride);
+        fft_fixed_axes_<Outer*N, S, Ns...>::run(x);
+    }
+};
+} // end of namespace extra
+
+/** Fourier transform of a contiguous container with compile-time extents Ns... (1, 2, 4, 8 or 16) along all axes,
+ * done in place with fft_kernel (no FFTW, no plans) : all extents, strides and loop bounds are compile-time constants, 
+ * so that the kernels are inlined into the loops. sign = -1 for a forward and +1 for a backward (normalized) transform.
+ * Example : run_fft_fixed<8,8>(e_k, -1) for data on an 8x8 kmesh. */
+template <size_t... Ns, typename BC>
+void run_fft_fixed(container_base<complex_type, sizeof...(Ns), BC>& in, int sign)
+{
+    const std::array<size_t, sizeof...(Ns)> shape = {{ Ns... }};
+    if (in.shape() != shape) throw ex_generic("run_fft_fixed : shape of the container doesn't match the kernels");
+    if (sign > 0) { 
+        extra::fft_fixed_axes_<1, 1, Ns...>::run(in.data()); 
+        in /= real_type(in.size()); 
+        }
+    else extra::fft_fixed_axes_<1, -1, Ns...>::run(in.data());
+}
+
+} // end of namespace gftools
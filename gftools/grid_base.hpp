@@ -1,12 +1,17 @@
 #pragma once
 
 #include <boost/operators.hpp>
+#include <boost/iterator/iterator_facade.hpp>
 
+#include <atomic>
+#include <cstdint>
 #include <iterator>
+#include <memory>
 #include <string>
 #include <vector>
 #include <algorithm>
 #include <functional>
+#include <numeric>
 
 #include "defaults.hpp"
 #include "exceptions.hpp"
@@ -57,16 +62,131 @@ template<typename T> std::ostream& operator<<(std::ostream& lhs, const point_bas
   lhs<<"{"<<p.value()<<"<-["<<p.index()<<"]}"; return lhs;
 }
 
-/** A one-dimensional grid, which stores an array of values. Typical examples: grid of real frequencies. Grid of k-points. Grid of Matsubara frequencies. Grid of imaginary times.*/
+/** A read-only random-access range of the points of a grid. The grid stores only the values of the points, 
+ * and points (value and index) are made on the fly by operator[] and by dereferencing the iterators. 
+ * The range refers to the values of the grid, so it is valid while the grid is alive and is not modified. */
+template <typename ValueType>
+class point_range {
+public:
+    typedef point_base<ValueType> point;
+    typedef point value_type;
+
+    /// Iterator over the points. Dereferencing returns a point by value.
+    class iterator : public boost::iterator_facade<iterator, point, std::random_access_iterator_tag, point> {
+    public:
+        iterator():vals_(nullptr),index_(0){}
+        iterator(const ValueType* vals, size_t index):vals_(vals),index_(index){}
+    private:
+        friend class boost::iterator_core_access;
+        point dereference() const { return point(vals_[index_], index_); }
+        bool equal(iterator const& rhs) const { return index_ == rhs.index_; }
+        void increment() { ++index_; }
+        void decrement() { --index_; }
+        void advance(std::ptrdiff_t n) { index_ += n; }
+        std::ptrdiff_t distance_to(iterator const& rhs) const { return std::ptrdiff_t(rhs.index_) - std::ptrdiff_t(index_); }
+
+        const ValueType* vals_;
+        size_t index_;
+    };
+    typedef iterator const_iterator;
+
+    point_range(const ValueType* vals, size_t size):vals_(vals),size_(size){}
+
+    iterator begin() const { return iterator(vals_, 0); }
+    iterator end() const { return iterator(vals_, size_); }
+    size_t size() const { return size_; }
+    bool empty() const { return size_ == 0; }
+    point operator[](size_t i) const { return point(vals_[i], i); }
+    point front() const { return (*this)[0]; }
+    point back() const { return (*this)[size_-1]; }
+
+protected:
+    const ValueType* vals_;
+    size_t size_;
+};
+
+/** Values of the points of a grid, shared by all copies of the grid (copy-on-write) : copying a grid (and a grid_object) 
+ * is O(1), the values are copied only if a shared copy is modified. Reads have the interface of a const std::vector. 
+ * The fingerprint (a hash of the bits of the values) is computed once and is shared by the copies, so that grids can be 
+ * compared by the identity of the storage or by the fingerprint before comparing the values. */
+template <typename T>
+class shared_values {
+public:
+    typedef std::vector<T> vector_type;
+    typedef T value_type;
+    typedef typename vector_type::const_iterator const_iterator;
+    typedef typename vector_type::iterator iterator;
+
+    shared_values():block_(std::make_shared<block>()){}
+    shared_values(vector_type const& v):block_(std::make_shared<block>(v)){}
+    shared_values(vector_type&& v):block_(std::make_shared<block>(std::move(v))){}
+    shared_values& operator=(vector_type const& v) { block_ = std::make_shared<block>(v); return *this; }
+    shared_values& operator=(vector_type&& v) { block_ = std::make_shared<block>(std::move(v)); return *this; }
+
+    // reads
+    vector_type const& get() const { return block_->values; }
+    operator vector_type const&() const { return block_->values; }
+    size_t size() const { return block_->values.size(); }
+    bool empty() const { return block_->values.empty(); }
+    T const& operator[](size_t i) const { return block_->values[i]; }
+    const T* data() const { return block_->values.data(); }
+    const_iterator begin() const { return block_->values.begin(); }
+    const_iterator end() const { return block_->values.end(); }
+
+    // writes : the values are copied first, if they are shared
+    T& operator[](size_t i) { return mutable_()[i]; }
+    iterator begin() { return mutable_().begin(); }
+    iterator end() { return mutable_().end(); }
+    void reserve(size_t n) { mutable_().reserve(n); }
+    void resize(size_t n) { mutable_().resize(n); }
+    void push_back(T const& x) { mutable_().push_back(x); }
+    void clear() { mutable_().clear(); }
+
+    /// true, if both share the same storage
+    bool shares(shared_values const& rhs) const { return block_ == rhs.block_; }
+    /// 64 bit FNV-1a hash of the bits of the values, computed on the first call
+    std::uint64_t fingerprint() const
+    {
+        std::uint64_t h = block_->fingerprint.load(std::memory_order_relaxed);
+        if (h) return h;
+        h = 14695981039346656037ull;
+        const unsigned char* bytes = reinterpret_cast<const unsigned char*>(block_->values.data());
+        for (size_t i = 0; i < block_->values.size() * sizeof(T); ++i) { h ^= bytes[i]; h *= 1099511628211ull; }
+        if (!h) h = 1;
+        block_->fingerprint.store(h, std::memory_order_relaxed);
+        return h;
+    }
+
+protected:
+    struct block {
+        block() = default;
+        block(vector_type const& v):values(v){}
+        block(vector_type&& v):values(std::move(v)){}
+        vector_type values;
+        /// 0 - not computed yet
+        mutable std::atomic<std::uint64_t> fingerprint { 0 };
+    };
+    vector_type& mutable_() 
+    { 
+        if (block_.use_count() > 1) block_ = std::make_shared<block>(block_->values); 
+        else block_->fingerprint.store(0, std::memory_order_relaxed);
+        return block_->values; 
+    }
+    std::shared_ptr<block> block_;
+};
+
+/** A one-dimensional grid, which stores an array of values. Typical examples: grid of real frequencies. Grid of k-points. Grid of Matsubara frequencies. Grid of imaginary times.
+ * Only the values are stored contiguously, the index of a point is its position, so points are made on demand. */
 template <typename ValueType, class Derived>
 class grid_base : public boost::equality_comparable<grid_base<ValueType, Derived> > {
 public:
     typedef point_base<ValueType> point;
     typedef ValueType value_type;
+    typedef point_range<ValueType> points_type;
 
     /** constructor a grid out of thin air. */
     grid_base();
-    /** construct a grid given a vector of points. */
+    /** construct a grid given a vector of points (their indices are ignored). */
     grid_base(const std::vector<point> & vals);
     /** construct a grid from a vector of values (but not associated indices that would be stored in points). */
     grid_base(const std::vector<ValueType> & vals);
@@ -75,10 +195,10 @@ public:
 
     /** Returns a value at given index. */
     point operator[](size_t in) const;
-    /** Returns all values. */
-    const std::vector<point> & points() const;
-    /** Returns values of all points. (computed on the fly, slow)*/
-    std::vector<ValueType> values() const;
+    /** Returns a range of all points. */
+    points_type points() const;
+    /** Returns values of all points (no copy is made). */
+    const std::vector<ValueType>& values() const;
     /** Checks if a point is present in a grid. */
     bool check_point(point in, real_type tolerance = std::numeric_limits<real_type>::epsilon()) const;
     /** Returns size of grid. */
@@ -88,17 +208,32 @@ public:
     point find_nearest(ValueType in) const;
     /** Get a value of an object at the given point, which is defined on a grid. */
     template <class Obj> auto eval(Obj &&in, point x) const ->decltype(in[0]);
+    /** Evaluate an object, which is defined on a grid, at n values : out[i] = eval(in, xs[i]). 
+      * Out is anything with an assignable operator[]. Grids may do it faster than one by one for sorted xs (see real_grid). */
+    template <class Obj, class Out> void eval_many(Obj &in, const ValueType* xs, size_t n, Out &&out) const;
+    /** Linear interpolation stencil at x : an object, defined on the grid, has the value w[0]*in[idx[0]] + w[1]*in[idx[1]] at x.
+      * Returns false, if x can't be interpolated. By default only the points of the grid are found (w = {1, 0}), 
+      * grids with an interpolation (real_grid, kmesh) override it. Used by grid_object for a multilinear interpolation. */
+    bool interpolation_stencil(ValueType x, size_t* idx, real_type* w) const;
 
     /** Shift a point by the given value. */
     point shift(point in, ValueType shift_arg) const;
     ValueType shift(ValueType in, ValueType shift_arg) const;
     point shift (point in, point shift_arg) const;
+    /** For each point of the grid returns the index of the point, shifted by the given value, or -1 if the shifted value is not on the grid. 
+      * This is computed once per grid, so that shifting a multidimensional object is done by index arithmetic. */
+    std::vector<int> shift_indices(ValueType shift_arg) const;
 
     // CRTP forwards: TODO: these will need to be cleaned for C++ and documented.
     /** Get a value of an object at the given coordinate, which is defined on a grid. */
     template <class Obj>
         auto eval(Obj &in, ValueType x) const ->decltype(in[0])
         { return static_cast<const Derived*>(this)->eval(in,x); };
+    /** Same as eval, but returns false (and leaves out untouched) instead of throwing, if x is not found in the grid. 
+      * Grids of gftools find x without exceptions; this default only catches the exception of Derived::eval. */
+    template <class Obj, typename V>
+        bool try_eval(Obj &in, ValueType x, V &out) const
+        { try { out = static_cast<const Derived*>(this)->eval(in,x); return true; } catch (gftools_exception&) { return false; } }
     /// Make the object printable.
     template <typename ValType, class Derived2> friend std::ostream& operator<<(std::ostream& lhs, const grid_base<ValType,Derived2> &gr);
     /// Compare 2 grids
@@ -128,7 +263,8 @@ public:
 
 
 protected:
-    std::vector<point> vals_;
+    /// values of the points (shared by the copies of the grid)
+    shared_values<ValueType> vals_;
 };
 
 namespace extra {
@@ -139,7 +275,7 @@ struct function_proxy {
     const Grid& grid_;
     function_proxy(F f, Grid const& grid):f_(f),grid_(grid){}
     typedef typename std::result_of<F(typename Grid::value_type)>::type value_type;
-    value_type operator[](int i) const {return f_((grid_.points()[i]).value()); }
+    value_type operator[](int i) const {return f_(grid_.values()[i]); }
 };
 }
 
@@ -154,16 +290,16 @@ grid_base<ValueType,Derived>::grid_base()
 {};
 
 template <typename ValueType, class Derived>
-grid_base<ValueType,Derived>::grid_base(const std::vector<point> &vals):vals_(vals)
+grid_base<ValueType,Derived>::grid_base(const std::vector<point> &vals)
 {
+    vals_.reserve(vals.size());
+    for (const auto& x : vals) vals_.push_back(x.value());
 };
 
 
 template <typename ValueType, class Derived>
-grid_base<ValueType,Derived>::grid_base(const std::vector<ValueType> &vals)
+grid_base<ValueType,Derived>::grid_base(const std::vector<ValueType> &vals):vals_(vals)
 {
-    vals_.reserve(vals.size());
-    for (size_t i=0; i<vals.size(); ++i) { vals_.emplace_back(point(vals[i], i)); };
 };
 
 template <typename ValueType, class Derived>
@@ -172,7 +308,7 @@ grid_base<ValueType,Derived>::grid_base(int min, int max, std::function<ValueTyp
     if (max<min) std::swap(min,max);
     size_t n_points = max-min;
     vals_.reserve(n_points);
-    for (size_t i=0; i<n_points; ++i) vals_.emplace_back(f(min+i), i) ;
+    for (size_t i=0; i<n_points; ++i) vals_.push_back(f(min+i));
 }
 
 template <typename ValueType, class Derived>
@@ -181,22 +317,19 @@ inline typename grid_base<ValueType,Derived>::point grid_base<ValueType,Derived>
     #ifndef NDEBUG
     if (index>vals_.size()) throw ex_wrong_index(index,this->size());
     #endif
-    return vals_[index];
+    return point(vals_[index], index);
 }
 
 template <typename ValueType, class Derived>
-inline const std::vector<typename grid_base<ValueType,Derived>::point> & grid_base<ValueType,Derived>::points() const
+inline typename grid_base<ValueType,Derived>::points_type grid_base<ValueType,Derived>::points() const
 {
-    return vals_;
+    return points_type(vals_.data(), vals_.size());
 }
 
 template <typename ValueType, class Derived>
-inline std::vector<ValueType> grid_base<ValueType,Derived>::values() const
+inline const std::vector<ValueType>& grid_base<ValueType,Derived>::values() const
 {
-    std::vector<ValueType> out;
-    out.reserve(vals_.size());
-    for (const auto& x : vals_) out.emplace_back(x.value());
-    return out;
+    return vals_;
 }
 
 template <typename ValueType, class Derived>
@@ -208,7 +341,7 @@ inline size_t grid_base<ValueType,Derived>::size() const
 template <typename ValueType, class Derived>
 inline bool grid_base<ValueType,Derived>::check_point(point in, real_type tolerance) const
 {
-    return (in.index() < vals_.size() && std::abs(in.value() - vals_[in.index()].value()) < tolerance);
+    return (in.index() < vals_.size() && std::abs(in.value() - vals_[in.index()]) < tolerance);
 }
 
 template <typename ValueType, class Derived>
@@ -219,6 +352,25 @@ inline auto grid_base<ValueType,Derived>::eval(Obj &&in, point x) const ->declty
     else throw ex_wrong_index(x.index(), this->size());
 }
 
+template <typename ValueType, class Derived>
+template <class Obj, class Out>
+inline void grid_base<ValueType,Derived>::eval_many(Obj &in, const ValueType* xs, size_t n, Out &&out) const
+{
+    const Derived& grid = static_cast<const Derived&>(*this);
+    for (size_t i=0; i<n; ++i) out[i] = grid.eval(in, xs[i]);
+}
+
+template <typename ValueType, class Derived>
+inline bool grid_base<ValueType,Derived>::interpolation_stencil(ValueType x, size_t* idx, real_type* w) const
+{
+    if (vals_.empty()) return false;
+    point p = static_cast<const Derived*>(this)->find_nearest(x);
+    if (std::abs(complex_type(p.value()) - complex_type(x)) >= 10.*std::numeric_limits<real_type>::epsilon()) return false;
+    idx[0] = idx[1] = p.index();
+    w[0] = 1.0; w[1] = 0.0;
+    return true;
+}
+
 template <typename ValueType, class Derived>
 inline typename grid_base<ValueType,Derived>::point grid_base<ValueType,Derived>::find_nearest(ValueType in) const
 {
@@ -226,8 +378,8 @@ inline typename grid_base<ValueType,Derived>::point grid_base<ValueType,Derived>
         "Default find_nearest is written only for less-comparable types");
     auto nearest_iter = std::lower_bound(vals_.begin(), vals_.end(), in, [](ValueType x, ValueType y){return x<y;});
     size_t dist = std::distance(vals_.begin(), nearest_iter);
-    if (dist > 0 && std::abs(complex_type(vals_[dist].value()) - complex_type(in)) > std::abs(complex_type(vals_[dist-1].value()) - complex_type(in)) ) dist--;
-    return vals_[dist];
+    if (dist == vals_.size() || (dist > 0 && std::abs(complex_type(vals_[dist]) - complex_type(in)) > std::abs(complex_type(vals_[dist-1]) - complex_type(in)))) dist--;
+    return point(vals_[dist], dist);
 }
 
 template <typename ValueType, class Derived>
@@ -237,7 +389,7 @@ inline typename grid_base<ValueType,Derived>::point grid_base<ValueType,Derived>
     ValueType out(in.value());
     out = static_cast<const Derived*>(this)->shift(ValueType(in),shift_arg);
     point p1 = static_cast<const Derived*>(this)->find_nearest(out);
-    if (!almost_equal(p1.value(), out, std::abs(p1.value() - ((p1.index()!=0)?vals_[p1.index() - 1]:vals_[p1.index()+1]).value())/10.)) {
+    if (!almost_equal(p1.value(), out, std::abs(p1.value() - ((p1.index()!=0)?vals_[p1.index() - 1]:vals_[p1.index()+1]))/10.)) {
 #ifndef NDEBUG
       ERROR("Couldn't shift point" <<  in << " by " << shift_arg << " got " << out);
 #endif
@@ -258,18 +410,38 @@ inline typename grid_base<ValueType,Derived>::point grid_base<ValueType,Derived>
     size_t index = (in.index() + shift_arg.index())%vals_.size();
     #ifndef NDEBUG
     ValueType val = static_cast<const Derived*>(this)->shift(in.value(), shift_arg.value());
-    if (!almost_equal(val, vals_[index].value())) throw gftools::ex_generic("grid_base::shift : almost equal failed.");
+    if (!almost_equal(val, vals_[index])) throw gftools::ex_generic("grid_base::shift : almost equal failed.");
     #endif
-    return vals_[index];
+    return point(vals_[index], index);
+
+}
 
+template <typename ValueType, class Derived>
+inline std::vector<int> grid_base<ValueType,Derived>::shift_indices(ValueType shift_arg) const
+{
+    std::vector<int> out(vals_.size());
+    if (almost_equal(shift_arg, 0.0)) { std::iota(out.begin(), out.end(), 0); return out; }
+    const Derived& grid = static_cast<const Derived&>(*this);
+    for (size_t i=0; i<vals_.size(); ++i) {
+        ValueType val = grid.shift(vals_[i], shift_arg);
+        point p1 = grid.find_nearest(val);
+        real_type tol = (vals_.size() > 1) 
+            ? std::abs(p1.value() - ((p1.index()!=0)?vals_[p1.index() - 1]:vals_[p1.index()+1]))/10.
+            : num_io<real_type>::tolerance();
+        out[i] = almost_equal(p1.value(), val, tol) ? int(p1.index()) : -1;
+    }
+    return out;
 }
 
 template <typename ValueType, class Derived>
 inline bool grid_base<ValueType,Derived>::operator==(const grid_base &rhs) const
 {
+    if (vals_.shares(rhs.vals_)) return true;
     bool out = (this->size() == rhs.size());
+    // bitwise equal values (grids, made the same way) are found by the fingerprints 
+    if (out && vals_.fingerprint() == rhs.vals_.fingerprint()) return true;
     for (size_t i=0; i<vals_.size() && out; i++) {
-        out = out && almost_equal(vals_[i].value(), rhs.vals_[i].value(), num_io<double>::tolerance());
+        out = out && almost_equal(vals_[i], rhs.vals_[i], num_io<double>::tolerance());
     }
     return out;
 }
@@ -281,7 +453,7 @@ std::ostream& operator<<(std::ostream& lhs, const grid_base<ValueType,Derived> &
     lhs << "{";
     //lhs << gr.vals_;
     std::ostream_iterator<ValueType> out_it (lhs,", ");
-    std::transform(gr.vals_.begin(),gr.vals_.end(), out_it, [](const typename grid_base<ValueType,Derived>::point &x){return ValueType(x);});
+    std::copy(gr.vals_.begin(),gr.vals_.end(), out_it);
     lhs << "}";
     return lhs;
 }
@@ -5,6 +5,7 @@
 #include "grid_base.hpp"
 #include "grid_tools.hpp"
 #include "container.hpp"
+#include "spline.hpp"
 
 namespace gftools {
 
@@ -17,6 +18,10 @@ class grid_object_base;
 template <typename ValueType, typename ... GridTypes>
 using grid_object = grid_object_base<container<ValueType, sizeof...(GridTypes)>, GridTypes...>;
 
+/// grid_object, that stores its data with a given allocator (see allocator.hpp)
+template <typename ValueType, typename Allocator, typename ... GridTypes>
+using grid_object_alloc = grid_object_base<container<ValueType, sizeof...(GridTypes), Allocator>, GridTypes...>;
+
 template <typename ValueType, typename ... GridTypes>
 using grid_object_ref = grid_object_base<container_ref<ValueType, sizeof...(GridTypes)>, GridTypes...>;
 
@@ -51,7 +56,7 @@ public:
     class exIOProblem : public std::exception { virtual const char* what() const throw(){return "IO problem.";} }; 
     class ex_wrong_index : public std::exception { virtual const char* what() const throw(){return "Index out of bounds";}}; 
 protected:
-    /// Grids on which the data is defined. 
+    /// Grids on which the data is defined (the copies share the values of the points, see shared_values). 
     const std::tuple<GridTypes...> grids_;
     /// Cache data dimensions. 
     const indices_t dims_;
@@ -59,6 +64,10 @@ protected:
     container_type data_;
     /// This function returns the value of the object when the point is not in container. 
     function_type tail_;
+    /// Interpolation along the first grid and its cached spline. 
+    extra::spline_cache<value_type> spline_;
+    /// Objects with other containers (e.g. refs) access the data in conversions. 
+    template <typename CT, typename ...GridTypes2> friend class grid_object_base;
 
 public:
     // Constructors
@@ -71,6 +80,9 @@ public:
     template <typename CType>
         grid_object_base( const std::tuple<GridTypes...> &grids, CType& data);
     grid_object_base( const std::tuple<GridTypes...> &grids, ContainerType&& data);
+    /// Constructor of grids and an expression of containers, that is evaluated into data. 
+    template <typename L, typename Op, typename R>
+        grid_object_base( const std::tuple<GridTypes...> &grids, const math_expr<L,Op,R>& data);
 
     /// Copy constructor. 
     grid_object_base( const grid_object_base<ContainerType, GridTypes...>& rhs);
@@ -97,12 +109,22 @@ public:
     arg_tuple get_args(point_tuple in) const { return trs::get_args(in, grids_); }
     indices_t get_indices(point_tuple in) const { return trs::get_indices(in, grids_); }
     /// Returns the data_ container. 
-    container_type& data(){return data_;}
+    container_type& data(){ spline_.modified(); return data_;}
     container_type const& data() const {return data_;}
     function_type const& tail(){return tail_;}
 
     void set_tail(function_type&& f){tail_ = f; }
     void set_tail(function_type const& f){tail_ = f; }
+    /** Set the interpolation along the first grid, that is used by operator() and eval_many of 1d objects (linear by default). 
+     * Splines need a grid, that provides them (real_grid), other grids ignore it. The spline is built on the first use and 
+     * is rebuilt after the data is modified by fill, loadtxt, assignments, arithmetic assignments and the non-const accessors 
+     * (data(), operator[], get, operator()(points)) of the object. Only a reference, that is kept and written to after 
+     * the next evaluation, should be followed by invalidate_interpolation(). */
+    void set_interpolation(interpolation kind) { spline_.set_kind(kind); }
+    /// Rebuild the spline at the next evaluation (call it after writing the data through a kept reference). O(1). 
+    void invalidate_interpolation() { spline_.invalidate(); }
+    /// Returns the interpolation along the first grid. 
+    interpolation get_interpolation() const { return spline_.kind(); }
 
 // Global operations - reductions, shifts 
     /// Returns the complex conjugate of this object, if it's complex valued. 
@@ -134,9 +156,9 @@ public:
 
 // Access operators
     /// Returns element number i, which corresponds to (*_grid)[i]. 
-    auto operator[](size_t i)->decltype(data_[i]) { return data_[i]; };
+    auto operator[](size_t i)->decltype(data_[i]) { spline_.modified(); return data_[i]; };
     auto operator[](size_t i) const -> const typename container_type::under_ref_type { return data_[i]; };
-    auto operator[](typename std::tuple_element<0,grid_tuple>::type::point in)->decltype(data_[0]) { assert(in.index() < grid<0>().size()); return data_[in.index()]; };
+    auto operator[](typename std::tuple_element<0,grid_tuple>::type::point in)->decltype(data_[0]) { assert(in.index() < grid<0>().size()); spline_.modified(); return data_[in.index()]; };
     auto operator[](typename std::tuple_element<0,grid_tuple>::type::point in) const -> const typename container_type::under_ref_type { assert(in.index() < grid<0>().size()); return data_[in.index()]; };
     //template <size_t M> value_type& operator[](const std::array<size_t,M>& in);
     /// Returns tail_(in). 
@@ -145,9 +167,9 @@ public:
         typename std::enable_if<std::is_convertible<std::tuple<ArgTypes...>, arg_tuple>::value, value_type>::type 
             tail_eval(ArgTypes...in) { return tail_(in...); };
     /// Return the value by grid values. 
-    value_type& get(const point_tuple& in) { return data_(get_indices(in)); }
+    value_type& get(const point_tuple& in) { spline_.modified(); return data_(get_indices(in)); }
 
-    value_type& operator()(const point_tuple& in) { return data_(get_indices(in)); }
+    value_type& operator()(const point_tuple& in) { spline_.modified(); return data_(get_indices(in)); }
     value_type operator()(const point_tuple& in) const { 
             try { return data_(get_indices(in)); } 
             catch (gftools::ex_generic&) { return this->tail_eval(in); };
@@ -155,28 +177,22 @@ public:
 
     template <int M=N>
     typename std::enable_if<(M>1 ), value_type>::type  operator()(arg_tuple in) const
-    	{  
-            
-            point_tuple x = trs::find_nearest(in, grids_); 
-            if (gftools::tools::is_float_equal<arg_tuple>(x,in)) {  return (*this)(x); } // FIXME with expression templates 
-            else { return this->tail_eval(in); };
-        // FIXME # warning grid_object::operator() doesn't provide interpolation for D>=2 
-        }
+        { value_type out; return this->interpolate_(in, out) ? out : this->tail_eval(in); }
     template <int M=N>
     typename std::enable_if<(M==1 ), value_type>::type  operator()(arg_tuple in) const
-        { try { return std::get<0>(grids_).eval(data_, std::get<0>(in)); } catch (gftools::gftools_exception&) { return this->tail_eval(in); } }
+        { value_type out; return this->try_eval0_(std::get<0>(in), out) ? out : this->tail_eval(in); }
 
     template <int M=N>
     typename std::enable_if<(M==1 ), value_type>::type
     operator()(typename std::tuple_element<0,grid_tuple>::type::point in) const { 
-        if (in.index() < grid().size() && tools::is_float_equal(in.value(), grid().points()[in.index()])) { return data_[in.index()]; } 
+        if (in.index() < grid().size() && tools::is_float_equal(in.value(), grid().values()[in.index()])) { return data_[in.index()]; } 
         return this->operator()(in.value()); 
         };
 
     template <int M=N>
     typename std::enable_if<(M==1 ), value_type&>::type
     operator()(typename std::tuple_element<0,grid_tuple>::type::point in)
-        { return data_[in.index()]; };
+        { spline_.modified(); return data_[in.index()]; };
 
 
     template <typename ...ArgTypes>
@@ -199,8 +215,7 @@ public:
 
     template <typename ArgType>
     	typename std::enable_if<std::is_same<std::tuple<ArgType>, arg_tuple>::value, value_type>::type
-    	 operator()(ArgType in) const { try { return std::get<0>(grids_).eval(data_, in); } 
-            catch (gftools::gftools_exception&) { return tail_(in); }; }
+    	 operator()(ArgType in) const { value_type out; return this->try_eval0_(in, out) ? out : tail_(in); }
 
     /*template <typename ArgType>
         	typename std::enable_if<std::is_same<std::tuple<ArgType>, arg_tuple>::value, value_type>::type
@@ -208,18 +223,42 @@ public:
 */
     /// Return value of grid_object. eval methods of grids are used, so interpolation is done if provided with grids
 
+    /// A typedef for the values of the first argument. 
+    typedef typename std::tuple_element<0, arg_tuple>::type arg0_type;
+    /** Evaluate the object at n values xs of the first argument (interpolating as the first grid does).
+     * For a 1d object out[i] = (*this)(xs[i]). Otherwise out receives n slices (*this)[xs[i]] of size()/grid<0>().size() 
+     * values each, one after another. The values, that are not on the grid, are taken from the tail.
+     * Sorted xs are much faster on a real_grid, which then finds all of them in one walk over the grid. */
+    void eval_many(const arg0_type* xs, size_t n, value_type* out) const;
+    /** Evaluate the object at n tuples of arguments : out[i] = (*this)(xs[i]). 
+     * For N>1 the values are multilinearly interpolated from the 2^N corners of the grid cell, that contains xs[i] 
+     * (linear along a real_grid, periodic along a kmesh, exact points only along other grids), the rest is taken from the tail. */
+    void eval_many(const arg_tuple* xs, size_t n, value_type* out) const;
+protected:
+    /// Multilinear interpolation of the data at in. Returns false, if in is out of some of the grids.
+    bool interpolate_(arg_tuple const& in, value_type& out) const;
+    /// Fill the data with f(points of grids...) (true_type) or f(values of grids...) (false_type) in nested loops over the grids.
+    template <typename Points, typename F> void fill_loops_(Points, F const& f);
+    /// Value of a 1d object at x, interpolated with the first grid. Returns false (no exceptions), if x is not found in the grid.
+    template <typename X> bool try_eval0_(X x, value_type& out) const 
+        { return extra::grid_try_eval_(grid_has_spline<typename std::tuple_element<0,grid_tuple>::type>(), std::get<0>(grids_), data_, spline_, x, out); }
+public:
+
 
 // Fill values
     /// Fills the container with a provided function. 
     void fill_function(const function_type &in);
     void fill_point_function(const point_function_type &in);
+    /** Fills the container with any callable of points (or of values) of the grids. The callable is not wrapped into std::function :
+     * the grids are walked in nested loops (the last grid innermost), so that it can be inlined into the loops. 
+     * With a parallel backend (see parallel.hpp) large objects are filled in parallel chunks, so the callable should be thread-safe. */
     template <typename F> 
         typename std::enable_if<std::is_convertible<typename std::remove_cv<F>::type, point_function_type>::value, void>::type fill(const F& f) {
-            this->fill_point_function(f); }
+            this->fill_loops_(std::true_type(), f); }
     template <typename F> 
         typename std::enable_if<std::is_convertible<typename std::remove_cv<F>::type, function_type>::value && 
                                 !std::is_convertible<typename std::remove_cv<F>::type, point_function_type>::value, void>::type fill(const F& f) { 
-            this->fill_function(f); }
+            this->fill_loops_(std::false_type(), f); tail_ = f; }
     void fill(const std::function<value_type(arg_tuple)>& in) { this->fill_function(tools::extract_tuple_f(in)); }
     void fill(const std::function<value_type(point_tuple)>& in) { this->fill_point_function(tools::extract_tuple_f(in)); }
     /// A shortcut for fill method. 
@@ -233,29 +272,38 @@ public:
 // Math (should be removed to an external algebra class). 
     grid_object_base& operator*= (const grid_object_base & rhs);
     grid_object_base& operator*= (const value_type& rhs);
-    grid_object<value_type, GridTypes...> operator* (const grid_object_base & rhs) const { gobj_t out(this->grids()); out.data() = this->data(); out*=rhs; return out; }  
-    grid_object<value_type, GridTypes...> operator* (const value_type & rhs) const { gobj_t out(*this); out*=rhs; return out; }
+    gobj_t operator* (const grid_object_base & rhs) const { return gobj_t(grids_, data_*rhs.data_); }  
+    gobj_t operator* (const value_type & rhs) const { gobj_t out(grids_, data_*rhs); out.set_tail(tail_); return out; }
     grid_object_base& operator+= (const grid_object_base & rhs);
     grid_object_base& operator+= (const value_type& rhs);
-    grid_object<value_type, GridTypes...> operator+ (const grid_object_base & rhs) const { gobj_t out(*this); out+=rhs; return out; }
-    grid_object<value_type, GridTypes...> operator+ (const value_type & rhs) const { gobj_t out(*this); out+=rhs; return out; }
+    gobj_t operator+ (const grid_object_base & rhs) const { gobj_t out(grids_, data_+rhs.data_); out.set_tail(tail_); return out; }
+    gobj_t operator+ (const value_type & rhs) const { gobj_t out(grids_, data_+rhs); out.set_tail(tail_); return out; }
     grid_object_base& operator-= (const grid_object_base & rhs);
     grid_object_base& operator-= (const value_type& rhs);
-    grid_object<value_type, GridTypes...> operator- (const grid_object_base & rhs) const { gobj_t out(*this); out-=rhs; return out; }
-    grid_object<value_type, GridTypes...> operator- (const value_type & rhs) const { gobj_t out(*this); out-=rhs; return out; }
+    gobj_t operator- (const grid_object_base & rhs) const { gobj_t out(grids_, data_-rhs.data_); out.set_tail(tail_); return out; }
+    gobj_t operator- (const value_type & rhs) const { gobj_t out(grids_, data_-rhs); out.set_tail(tail_); return out; }
     grid_object_base& operator/= (const grid_object_base & rhs);
     grid_object_base& operator/= (const value_type& rhs);
-    grid_object<value_type, GridTypes...> operator/ (const grid_object_base & rhs) const { gobj_t out(*this); out/=rhs; return out; }
-    grid_object<value_type, GridTypes...> operator/ (const value_type & rhs) const { gobj_t out(*this); out/=rhs; return out; }
-    friend grid_object<value_type, GridTypes...> operator* (const value_type & lhs, const grid_object_base & rhs) {return rhs*lhs;};
-    friend grid_object<value_type, GridTypes...> operator+ (const value_type & lhs, const grid_object_base & rhs) {return rhs+lhs;};
-    friend grid_object<value_type, GridTypes...> operator- (const value_type & lhs, const grid_object_base & rhs) {return rhs*(-1.0)+lhs;};
-    friend grid_object<value_type, GridTypes...> operator/ (const value_type & lhs, const grid_object_base & rhs) {grid_object_base out(rhs); out=lhs; return out/rhs;};
+    gobj_t operator/ (const grid_object_base & rhs) const { gobj_t out(grids_, data_/rhs.data_); out.set_tail(tail_); return out; }
+    gobj_t operator/ (const value_type & rhs) const { gobj_t out(grids_, data_/rhs); out.set_tail(tail_); return out; }
+    friend gobj_t operator* (const value_type & lhs, const grid_object_base & rhs) {return rhs*lhs;};
+    friend gobj_t operator+ (const value_type & lhs, const grid_object_base & rhs) {return rhs+lhs;};
+    friend gobj_t operator- (const value_type & lhs, const grid_object_base & rhs) { gobj_t out(rhs.grids_, lhs-rhs.data_); out.set_tail(rhs.tail_); return out; };
+    friend gobj_t operator/ (const value_type & lhs, const grid_object_base & rhs) { 
+        gobj_t out(rhs.grids_, lhs/rhs.data_); out.set_tail(tools::fun_traits<function_type>::constant(lhs)); return out; };
 };
 
 template <typename GridObjectType>
 GridObjectType loadtxt(std::string const& fname, double tol = 1e-8);
 
+/** Call f(element, points of grids...) for every element of obj, in parallel for large objects (see parallel.hpp). 
+ * The elements are visited in chunks of contiguous memory, the order of the calls is unspecified. */
+template <typename ContainerType, typename ...GridTypes, typename F>
+void parallel_for_grid(grid_object_base<ContainerType,GridTypes...>& obj, F&& f);
+/// Same for a constant object : f(const element, points of grids...).
+template <typename ContainerType, typename ...GridTypes, typename F>
+void parallel_for_grid(grid_object_base<ContainerType,GridTypes...> const& obj, F&& f);
+
 
 /*
 /// A helper recursive template utility to extract and set data from the container.
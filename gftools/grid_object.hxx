@@ -1,6 +1,7 @@
 #pragma once
 
 #include <boost/functional/hash.hpp>
+#include <sstream>
 #include <unordered_set>
 #include "grid_object.hpp"
 
@@ -44,11 +45,23 @@ grid_object_base<ContainerType,GridTypes...>::grid_object_base( const std::tuple
     if (dims_ != data.shape()) throw gftools::ex_generic("Dimensions mismatch when creating grid_object from existing data");
 };
 
+template <typename ContainerType, typename ...GridTypes>
+template <typename L, typename Op, typename R>
+grid_object_base<ContainerType,GridTypes...>::grid_object_base( const std::tuple<GridTypes...> &grids, const math_expr<L,Op,R>& data):
+    grids_(grids),
+    dims_(trs::get_dimensions(grids)),
+    data_(data),
+    tail_(tools::fun_traits<function_type>::constant(0.0))
+{
+    if (dims_ != data.shape()) throw gftools::ex_generic("Dimensions mismatch when creating grid_object from an expression");
+};
+
 template <typename ContainerType, typename ...GridTypes>
 grid_object_base<ContainerType,GridTypes...>::grid_object_base( grid_object_base<ContainerType,GridTypes...> && rhs):
     grids_(rhs.grids_),
     dims_(rhs.dims_),
-    data_(std::forward<ContainerType>(rhs.data_))
+    data_(std::forward<ContainerType>(rhs.data_)),
+    spline_(rhs.spline_)
 {
     tail_.swap(rhs.tail_);
 }
@@ -58,7 +71,8 @@ grid_object_base<ContainerType,GridTypes...>::grid_object_base( const grid_objec
     grids_(rhs.grids_),
     dims_(rhs.dims_),
     data_(rhs.data_),
-    tail_(rhs.tail_)
+    tail_(rhs.tail_),
+    spline_(rhs.spline_)
 {
 };
 
@@ -69,7 +83,8 @@ grid_object_base<ContainerType,GridTypes...>::grid_object_base( const grid_objec
     grids_(rhs.grids_),
     dims_(rhs.dims_),
     data_(rhs.data_),
-    tail_(rhs.tail_)
+    tail_(rhs.tail_),
+    spline_(rhs.spline_)
 {
 }
 //
@@ -84,6 +99,7 @@ grid_object_base<ContainerType,GridTypes...>& grid_object_base<ContainerType,Gri
     assert(dims_ == rhs.dims_);
     data_=rhs.data_;
     tail_ = rhs.tail_;
+    spline_ = rhs.spline_;
     return *this;
 }
 
@@ -96,6 +112,7 @@ grid_object_base<ContainerType,GridTypes...>& grid_object_base<ContainerType,Gri
     if (rhs.size() != this->size()) throw gftools::ex_generic("Assigning objects of different sizes");
     data_=rhs.data_;
     tail_ = rhs.tail_;
+    spline_ = rhs.spline_;
     return *this;
 }
 
@@ -105,6 +122,7 @@ grid_object_base<ContainerType,GridTypes...>& grid_object_base<ContainerType,Gri
 {
     data_=rhs;
     tail_ = tools::fun_traits<function_type>::constant(rhs);
+    spline_.invalidate();
     return *this;
 }
 
@@ -115,10 +133,26 @@ grid_object_base<ContainerType,GridTypes...>& grid_object_base<ContainerType,Gri
     if (rhs.size() != this->size()) throw gftools::ex_generic("Assigning objects of different sizes");
     data_.swap(rhs.data_);
     tail_.swap(rhs.tail_);
+    spline_ = rhs.spline_;
     return *this;
 }
 
 
+namespace extra {
+template <size_t D>
+inline std::array<size_t, D> enumerate_indices_(const size_t index, const std::array<size_t, D> dims)
+{
+    std::array<size_t, D> indices;
+    size_t t = index;
+    for (int i=D-1; i>=0; i--) {
+        indices[i]=t%dims[i];
+        t-=indices[i];
+        t/=dims[i];
+        }
+    return indices;
+}
+} // end of namespace extra
+
 //
 // shift
 //
@@ -131,25 +165,59 @@ typename std::enable_if<
     grid_object<typename grid_object_base<ContainerType,GridTypes...>::value_type, GridTypes...>>::type
         grid_object_base<ContainerType,GridTypes...>::shift (const std::tuple<ArgTypes...>& shift_args) const
 {
-    grid_object_base<ContainerType,GridTypes...> out(grids_);
-    std::function<value_type(point_tuple)> ShiftFunction = [&](point_tuple args1)->value_type {
-        try { point_tuple out_args = trs::shift(args1, shift_args,grids_); return (*this)(out_args); }
-        catch (...)
-            { arg_tuple out_args = trs::shift(arg_tuple(args1), arg_tuple(shift_args) ,grids_); return (*this)(out_args); }
-    //    __tuple_print<point_tuple>::print(args1);
-    //    INFO_NONEWLINE("+");  __tuple_print<std::tuple<ArgTypes...>>::print(shift_args);
-    //    INFO_NONEWLINE("-->");__tuple_print<point_tuple>::print(out_args);
-        };
-    out.fill(ShiftFunction);
+    // Shifts are done by values: point arguments are converted to their values. 
+    const arg_tuple shift_vals(shift_args);
+    grid_object<value_type, GridTypes...> out(grids_);
+
+    // source index of each point along each axis, computed once per axis (-1 if the point is shifted out of the grid)
+    const typename trs::index_maps maps = trs::shift_indices(shift_vals, grids_);
+    const indices_t dims = trs::get_dimensions(grids_);
+    const size_t last = dims[N-1];
+    const size_t nrows = this->size() / last;
+    const std::vector<int>& last_map = maps[N-1];
+
+    const value_type* src = data_.data();
+    value_type* const out_data = out.data().data();
+
+    // rows along the last grid are independent : ranges of rows are shifted in parallel for large objects
+    parallel::for_each_range(nrows, this->size(), [&](size_t row_begin, size_t row_end) { 
+        indices_t index = extra::enumerate_indices_(row_begin * last, dims);
+        value_type* dst = out_data + row_begin * last;
+        for (size_t row = row_begin; row < row_end; ++row, dst += last) { 
+            bool row_on_grid = true;
+            size_t src_row = 0;
+            for (size_t d = 0; d + 1 < N; ++d) { 
+                int i = maps[d][index[d]];
+                row_on_grid = row_on_grid && i >= 0;
+                src_row = src_row * dims[d] + std::max(i, 0);
+                }
+            const value_type* src_data = src + src_row * last;
+            for (size_t j = 0; j < last; ) { 
+                if (row_on_grid && last_map[j] >= 0) { 
+                    // copy the whole run of consecutive source points at once
+                    size_t k = j + 1;
+                    while (k < last && last_map[k] == last_map[k-1] + 1) ++k;
+                    std::copy(src_data + last_map[j], src_data + last_map[j] + (k - j), dst + j);
+                    j = k;
+                    }
+                else { 
+                    // the point is shifted out of the grid - use the interpolation/tail
+                    index[N-1] = j;
+                    dst[j] = (*this)(trs::shift(trs::get_args(index, grids_), shift_vals, grids_));
+                    ++j;
+                    }
+                }
+            for (int d = int(N) - 2; d >= 0; --d) { if (++index[d] < dims[d]) break; index[d] = 0; }
+            }
+        });
 
-    static std::function<value_type(arg_tuple)> ShiftAnalyticF;
-    ShiftAnalyticF = [this, shift_args](const arg_tuple& in)->value_type {
-        arg_tuple out_args = trs::shift(in,shift_args,grids_);
-        return tuple_tools::unfold_tuple(this->tail_, out_args);
+    const function_type tail = tail_;
+    const grid_tuple grids = grids_;
+    std::function<value_type(arg_tuple)> ShiftAnalyticF = [tail, grids, shift_vals](const arg_tuple& in)->value_type {
+        arg_tuple out_args = trs::shift(in,shift_vals,grids);
+        return tuple_tools::unfold_tuple(tail, out_args);
     };
-
-    function_type tailF = tools::extract_tuple_f(ShiftAnalyticF);
-    out.tail_ = tailF;
+    out.set_tail(tools::extract_tuple_f(ShiftAnalyticF));
 
     return out;
 }
@@ -158,21 +226,6 @@ typename std::enable_if<
 // IO
 //
 
-namespace extra {
-template <size_t D>
-inline std::array<size_t, D> enumerate_indices_(const size_t index, const std::array<size_t, D> dims)
-{
-    std::array<size_t, D> indices;
-    size_t t = index;
-    for (int i=D-1; i>=0; i--) {
-        indices[i]=t%dims[i];
-        t-=indices[i];
-        t/=dims[i];
-        }
-    return indices;
-}
-} // end of namespace extra
-
 template <typename ContainerType, typename ...GridTypes>
 std::ostream& operator<<(std::ostream& lhs, const grid_object_base<ContainerType,GridTypes...> &in)
 {
@@ -190,14 +243,31 @@ void grid_object_base<ContainerType,GridTypes...>::savetxt(const std::string& fn
     out.open(fname.c_str());
     size_t total_size = this->size();
     size_t last_grid_size = std::get<N-1>(grids_).size();
-    for (size_t i=0; i<total_size; ++i) {
-        auto pts_index = extra::enumerate_indices_(i, dims_);
-        //arg_tuple args = this->getArgsFromIndices(pts_index);
-        point_tuple pts = this->points(pts_index);
-        auto val = data_(pts_index);
-        out << std::scientific << tuple_tools::serialize_tuple<arg_tuple>(pts) << "    " << num_io<value_type>(val) << std::endl;
-        if (N > 1 && i && (i+1)%last_grid_size==0) out << std::endl;
+    auto write_lines = [&](std::ostream& os, size_t begin, size_t end) { 
+        for (size_t i=begin; i<end; ++i) {
+            auto pts_index = extra::enumerate_indices_(i, dims_);
+            //arg_tuple args = this->getArgsFromIndices(pts_index);
+            point_tuple pts = this->points(pts_index);
+            auto val = data_(pts_index);
+            os << std::scientific << tuple_tools::serialize_tuple<arg_tuple>(pts) << "    " << num_io<value_type>(val) << "\n";
+            if (N > 1 && i && (i+1)%last_grid_size==0) os << "\n";
+            };
         };
+    if (!parallel::use_parallel(total_size)) write_lines(out, 0, total_size);
+    else { 
+        // lines are formatted in parallel in blocks of io_block lines and written in order
+        const size_t io_block = 4096, nblocks_max = 16 * size_t(parallel::num_threads());
+        std::vector<std::string> text(nblocks_max);
+        for (size_t b0 = 0; b0 < total_size; b0 += nblocks_max * io_block) { 
+            const size_t nblocks = std::min(nblocks_max, (total_size - b0 + io_block - 1) / io_block);
+            parallel::run(nblocks, [&](size_t b) { 
+                std::ostringstream os;
+                write_lines(os, b0 + b*io_block, std::min(total_size, b0 + (b+1)*io_block));
+                text[b] = os.str();
+                });
+            for (size_t b = 0; b < nblocks; ++b) out << text[b];
+            }
+        }
     out.close();
 }
 
@@ -205,6 +275,7 @@ template <typename ContainerType, typename ...GridTypes>
 void grid_object_base<ContainerType,GridTypes...>::loadtxt(const std::string& fname, real_type tol)
 {
     INFO("Loading " << demangled_name(typeid(*this)) << " from " << fname);
+    spline_.invalidate();
     std::ifstream in;
     in.open(fname.c_str());
     if (in.fail()) { ERROR("Couldn't open file " << fname); throw exIOProblem(); };
@@ -228,31 +299,235 @@ void grid_object_base<ContainerType,GridTypes...>::loadtxt(const std::string& fn
 // Fill values
 //
 
+namespace extra {
+/** Nested loops over the grids D, D+1, ... N-1 of a tuple : calls f with the arguments of the outer loops and 
+ * a point (true_type) or a value (false_type) of each grid, and stores the results one after another at out. */
+template <size_t D, size_t N, bool Last = (D+1 == N)>
+struct fill_loop_ {
+    template <typename Grids, typename F, typename ValueType, typename ...Args>
+    static void run(std::true_type, Grids const& grids, F const& f, ValueType*& out, Args const&... args)
+    {
+        auto const& grid = std::get<D>(grids);
+        for (size_t i=0; i<grid.size(); ++i) fill_loop_<D+1,N>::run(std::true_type(), grids, f, out, args..., grid[i]);
+    }
+    template <typename Grids, typename F, typename ValueType, typename ...Args>
+    static void run(std::false_type, Grids const& grids, F const& f, ValueType*& out, Args const&... args)
+    {
+        auto const& vals = std::get<D>(grids).values();
+        for (size_t i=0; i<vals.size(); ++i) fill_loop_<D+1,N>::run(std::false_type(), grids, f, out, args..., vals[i]);
+    }
+};
+
+/// The innermost loop : a plain loop over the last grid, that writes contiguous values.
+template <size_t D, size_t N>
+struct fill_loop_<D,N,true> {
+    template <typename Grids, typename F, typename ValueType, typename ...Args>
+    static void run(std::true_type, Grids const& grids, F const& f, ValueType*& out, Args const&... args)
+    {
+        auto const& grid = std::get<D>(grids);
+        const size_t n = grid.size();
+        for (size_t i=0; i<n; ++i) out[i] = f(args..., grid[i]);
+        out += n;
+    }
+    template <typename Grids, typename F, typename ValueType, typename ...Args>
+    static void run(std::false_type, Grids const& grids, F const& f, ValueType*& out, Args const&... args)
+    {
+        const auto* vals = std::get<D>(grids).values().data();
+        const size_t n = std::get<D>(grids).size();
+        for (size_t i=0; i<n; ++i) out[i] = f(args..., vals[i]);
+        out += n;
+    }
+};
+
+/// a point of a grid (true_type) or its value (false_type)
+template <typename Grid>
+typename Grid::point grid_arg_(std::true_type, Grid const& grid, size_t i) { return grid[i]; }
+template <typename Grid>
+typename Grid::value_type const& grid_arg_(std::false_type, Grid const& grid, size_t i) { return grid.values()[i]; }
+
+/** Calls visit(k, args...) for the elements [begin, end) of flattened data with dimensions dims, args are the points (true_type) 
+ * or the values (false_type) of the grids at the element k. Used for the chunks of parallel loops over grid_objects. */
+template <int ...S, typename Points, typename Grids, size_t D, typename Visitor>
+void for_each_index_(tuple_tools::extra::arg_seq<S...>, Points, Grids const& grids, std::array<size_t,D> const& dims, 
+                     size_t begin, size_t end, Visitor const& visit)
+{
+    std::array<size_t,D> index = enumerate_indices_(begin, dims);
+    for (size_t k = begin; k < end; ) { 
+        // the rest of the row along the last grid, then count the indices of the outer grids up
+        size_t row_end = std::min(end, k + dims[D-1] - index[D-1]);
+        for (; k < row_end; ++k, ++index[D-1]) visit(k, grid_arg_(Points(), std::get<S>(grids), index[S])...);
+        index[D-1] = 0;
+        for (int d = int(D)-2; d >= 0 && ++index[d] == dims[d]; --d) index[d] = 0;
+        }
+}
+
+/// stores f(args...) at out[k]
+template <typename ValueType, typename F>
+struct fill_writer_ {
+    ValueType* out;
+    F const& f;
+    template <typename ...Args> void operator()(size_t k, Args const&... args) const { out[k] = f(args...); }
+};
+/// calls f(data[k], points...)
+template <typename ValueType, typename F>
+struct point_visitor_ {
+    ValueType* data;
+    F& f;
+    template <typename ...Args> void operator()(size_t k, Args const&... args) const { f(data[k], args...); }
+};
+} // end of namespace extra
+
+template <typename ContainerType, typename ...GridTypes>
+template <typename Points, typename F>
+void grid_object_base<ContainerType,GridTypes...>::fill_loops_(Points, F const& f)
+{
+    spline_.invalidate();
+    value_type* out = data_.data();
+    const size_t n = this->size();
+    if (!parallel::use_parallel(n)) { extra::fill_loop_<0,N>::run(Points(), grids_, f, out); return; }
+    const extra::fill_writer_<value_type, F> writer = { out, f };
+    parallel::for_each_chunk(out, n, [&](size_t begin, size_t end){ 
+        extra::for_each_index_(typename trs::index_gen(), Points(), grids_, dims_, begin, end, writer); });
+}
+
+namespace extra {
+template <typename ValueType, typename Grids, size_t D, typename F>
+void parallel_for_grid_(ValueType* data, Grids const& grids, std::array<size_t,D> const& dims, size_t n, F& f)
+{
+    const point_visitor_<ValueType, F> visit = { data, f };
+    typedef typename tuple_tools::extra::index_gen<D>::type index_gen;
+    parallel::for_each_chunk(data, n, [&](size_t begin, size_t end){ 
+        for_each_index_(index_gen(), std::true_type(), grids, dims, begin, end, visit); });
+}
+} // end of namespace extra
+
+template <typename ContainerType, typename ...GridTypes, typename F>
+void parallel_for_grid(grid_object_base<ContainerType,GridTypes...>& obj, F&& f)
+{
+    auto& data = obj.data();
+    extra::parallel_for_grid_(data.data(), obj.grids(), tools::grid_tuple_traits<std::tuple<GridTypes...>>::get_dimensions(obj.grids()), 
+                              obj.size(), f);
+    obj.invalidate_interpolation();
+}
+
+template <typename ContainerType, typename ...GridTypes, typename F>
+void parallel_for_grid(grid_object_base<ContainerType,GridTypes...> const& obj, F&& f)
+{
+    extra::parallel_for_grid_(obj.data().data(), obj.grids(), tools::grid_tuple_traits<std::tuple<GridTypes...>>::get_dimensions(obj.grids()), 
+                              obj.size(), f);
+}
+
 template <typename ContainerType, typename ...GridTypes>
 void grid_object_base<ContainerType,GridTypes...>::fill_point_function(const typename grid_object_base<ContainerType,GridTypes...>::point_function_type& in)
 {
-    size_t total_size = this->size();
-    for (size_t i=0; i<total_size; ++i) {
-        auto pts_index = extra::enumerate_indices_(i, dims_);
-        point_tuple args = trs::points(pts_index,grids_);
-        auto val = tuple_tools::unfold_tuple(in, args);
-        data_(pts_index) = val;
-        };
+    this->fill_loops_(std::true_type(), in);
 }
 
 template <typename ContainerType, typename ...GridTypes>
 void grid_object_base<ContainerType,GridTypes...>::fill_function(const typename grid_object_base<ContainerType,GridTypes...>::function_type& in)
 {
-    size_t total_size = this->size();
-    for (size_t i=0; i<total_size; ++i) {
-        auto pts_index = extra::enumerate_indices_(i, dims_);
-        arg_tuple args = trs::get_args(pts_index,grids_);
-        auto val = tuple_tools::unfold_tuple(in, args);
-        data_(pts_index) = val;
-        };
+    this->fill_loops_(std::false_type(), in);
     tail_ = in;
 }
 
+namespace extra {
+/// A view of contiguous memory as an array of equal slices (Eigen maps), so that grids can interpolate whole slices. 
+template <typename ValueType>
+struct slice_view {
+    typedef Eigen::Array<typename std::remove_const<ValueType>::type, Eigen::Dynamic, 1> array_type;
+    typedef Eigen::Map<typename std::conditional<std::is_const<ValueType>::value, const array_type, array_type>::type> map_type;
+    slice_view(ValueType* data, size_t size):data_(data),size_(size){}
+    map_type operator[](size_t i) const { return map_type(data_ + i*size_, size_); }
+    ValueType* data_;
+    size_t size_;
+};
+
+/// eval_many of a grid for a 1d container
+template <typename Grid, typename Container, typename ArgType, typename ValueType>
+void eval_many_(std::true_type, Grid const& grid, Container const& data, spline_cache<ValueType> const& cache, 
+                const ArgType* xs, size_t n, ValueType* out, size_t)
+{
+    grid_eval_many_(grid_has_spline<Grid>(), grid, data, cache, xs, n, out);
+}
+
+/// eval_many of a grid for slices of a multidimensional container (linear interpolation)
+template <typename Grid, typename Container, typename ArgType, typename ValueType>
+void eval_many_(std::false_type, Grid const& grid, Container const& data, spline_cache<ValueType> const&, 
+                const ArgType* xs, size_t n, ValueType* out, size_t stride)
+{
+    const slice_view<const ValueType> in_slices(data.data(), stride);
+    grid.eval_many(in_slices, xs, n, slice_view<ValueType>(out, stride));
+}
+
+/// non-throwing value of a 1d container at x
+template <typename Grid, typename Container, typename ArgType, typename ValueType>
+bool try_eval_(std::true_type, Grid const& grid, Container const& data, spline_cache<ValueType> const& cache, 
+               ArgType x, ValueType* out, size_t)
+{
+    return grid_try_eval_(grid_has_spline<Grid>(), grid, data, cache, x, *out);
+}
+
+/// non-throwing value of a slice of a multidimensional container at x (linear interpolation)
+template <typename Grid, typename Container, typename ArgType, typename ValueType>
+bool try_eval_(std::false_type, Grid const& grid, Container const& data, spline_cache<ValueType> const&, 
+               ArgType x, ValueType* out, size_t stride)
+{
+    const slice_view<const ValueType> in_slices(data.data(), stride);
+    auto out_slice = slice_view<ValueType>(out, stride)[0];
+    return grid.try_eval(in_slices, x, out_slice);
+}
+} // end of namespace extra
+
+template <typename ContainerType, typename ...GridTypes>
+void grid_object_base<ContainerType,GridTypes...>::eval_many(const arg0_type* xs, size_t n, value_type* out) const
+{
+    auto const& grid = std::get<0>(grids_);
+    const size_t stride = data_.size() / dims_[0];
+    typedef std::integral_constant<bool, N == 1> is_1d;
+    try { 
+        extra::eval_many_(is_1d(), grid, data_, spline_, xs, n, out, stride);
+        }
+    catch (gftools::gftools_exception&) { 
+        // some values are outside of the grid : go one by one without exceptions
+        for (size_t i=0; i<n; ++i) { 
+            value_type* out_i = out + i*stride;
+            if (extra::try_eval_(is_1d(), grid, data_, spline_, xs[i], out_i, stride)) continue;
+            for (size_t j=0; j<stride; ++j) { 
+                arg_tuple args = trs::get_args(extra::enumerate_indices_(j, dims_), grids_);
+                std::get<0>(args) = xs[i];
+                out_i[j] = this->tail_eval(args);
+                }
+            }
+        }
+}
+
+template <typename ContainerType, typename ...GridTypes>
+void grid_object_base<ContainerType,GridTypes...>::eval_many(const arg_tuple* xs, size_t n, value_type* out) const
+{
+    for (size_t i=0; i<n; ++i) out[i] = (*this)(xs[i]);
+}
+
+template <typename ContainerType, typename ...GridTypes>
+bool grid_object_base<ContainerType,GridTypes...>::interpolate_(arg_tuple const& in, value_type& out) const
+{
+    typename trs::stencil_indices idx;
+    typename trs::stencil_weights w;
+    if (!trs::find_stencils(in, grids_, idx, w)) return false;
+    // sum over the 2^N corners of the cell. Zero weights are skipped, so the points of the grids give the stored values.
+    indices_t pos;
+    out = value_type(0);
+    for (size_t c=0; c < (size_t(1) << N); ++c) { 
+        real_type wc = 1.0;
+        for (size_t d=0; d<N && wc != 0.0; ++d) { 
+            size_t b = (c >> d) & 1;
+            wc *= w[d][b];
+            pos[d] = idx[d][b];
+            }
+        if (wc != 0.0) out += wc * data_(pos);
+        }
+    return true;
+}
+
 template <typename ContainerType, typename ...GridTypes>
 template <typename CType2>
 grid_object_base<ContainerType,GridTypes...>& grid_object_base<ContainerType,GridTypes...>::copy_interpolate (
@@ -286,6 +561,7 @@ grid_object_base<ContainerType,GridTypes...>& grid_object_base<ContainerType,Gri
     const grid_object_base<ContainerType,GridTypes...>& rhs)
 {
     //static_assert(rhs.grids_ == grids_, "Grid mismatch");
+    spline_.invalidate();
     data_+=rhs.data_;
     //_f=tools::fun_traits<function_type>::add(_f, rhs._f);
     return *this;
@@ -295,6 +571,7 @@ template <typename ContainerType, typename ...GridTypes>
 grid_object_base<ContainerType,GridTypes...>& grid_object_base<ContainerType,GridTypes...>::operator+= (
     const value_type & rhs)
 {
+    spline_.invalidate();
     data_+=rhs;
     //tail_=tools::fun_traits<function_type>::add(tail_, tools::fun_traits<function_type>::constant(rhs));
     return *this;
@@ -306,6 +583,7 @@ grid_object_base<ContainerType,GridTypes...>& grid_object_base<ContainerType,Gri
     const grid_object_base<ContainerType,GridTypes...>& rhs)
 {
     //static_assert(rhs.grids_ == grids_, "Grid mismatch");
+    spline_.invalidate();
     data_*=rhs.data_;
     //tail_=tools::fun_traits<function_type>::multiply(tail_, rhs.tail_);
     return *this;
@@ -315,6 +593,7 @@ template <typename ContainerType, typename ...GridTypes>
 grid_object_base<ContainerType,GridTypes...>& grid_object_base<ContainerType,GridTypes...>::operator*= (
     const value_type & rhs)
 {
+    spline_.invalidate();
     data_*=rhs;
     //tail_=tools::fun_traits<function_type>::multiply(tail_, tools::fun_traits<function_type>::constant(rhs));
     return *this;
@@ -326,6 +605,7 @@ grid_object_base<ContainerType,GridTypes...>& grid_object_base<ContainerType,Gri
     const grid_object_base<ContainerType,GridTypes...>& rhs)
 {
     //static_assert(rhs.grids_ == grids_, "Grid mismatch");
+    spline_.invalidate();
     data_/=rhs.data_;
     //tail_=tools::fun_traits<function_type>::divide(tail_, rhs.tail_);
     return *this;
@@ -335,6 +615,7 @@ template <typename ContainerType, typename ...GridTypes>
 grid_object_base<ContainerType,GridTypes...>& grid_object_base<ContainerType,GridTypes...>::operator/= (
     const value_type & rhs)
 {
+    spline_.invalidate();
     data_/=rhs;
     //tail_=tools::fun_traits<function_type>::divide(tail_, tools::fun_traits<function_type>::constant(rhs));
     return *this;
@@ -346,6 +627,7 @@ grid_object_base<ContainerType,GridTypes...>& grid_object_base<ContainerType,Gri
     const grid_object_base<ContainerType,GridTypes...>& rhs)
 {
     //static_assert(rhs.grids_ == grids_, "Grid mismatch");
+    spline_.invalidate();
     data_-=rhs.data_;
     //tail_=tools::fun_traits<function_type>::subtract(tail_, rhs.tail_);
     return *this;
@@ -355,6 +637,7 @@ template <typename ContainerType, typename ...GridTypes>
 grid_object_base<ContainerType,GridTypes...>& grid_object_base<ContainerType,GridTypes...>::operator-= (
     const value_type & rhs)
 {
+    spline_.invalidate();
     data_-=rhs;
     //tail_=tools::fun_traits<function_type>::subtract(tail_, tools::fun_traits<function_type>::constant(rhs));
     return *this;
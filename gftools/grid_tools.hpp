@@ -32,6 +32,8 @@ struct grid_tuple_traits<std::tuple<GridTypes...> >
     typedef typename GridArgTypeExtractor<std::true_type, std::tuple<GridTypes...> >::arg_tuple arg_tuple;
     /// A typedef for a set of indices. 
     typedef std::array<size_t, N> indices;
+    /// A typedef for a set of index maps - one per grid.
+    typedef std::array<std::vector<int>, N> index_maps;
 
     /// Convert indices to points.
     static point_tuple points(indices const& in, const grid_tuple_type& grids) { return points_(index_gen(),in,grids); }
@@ -49,10 +51,18 @@ struct grid_tuple_traits<std::tuple<GridTypes...> >
 
     /// Find a tuple of nearest points to the given tuple of values
     static point_tuple find_nearest(arg_tuple const& in, const grid_tuple_type& grids) { return find_nearest_(index_gen(),in,grids); }
+    /// Linear interpolation stencils of all grids (2 indices and 2 weights per grid, see grid_base::interpolation_stencil).
+    typedef std::array<std::array<size_t,2>, N> stencil_indices;
+    typedef std::array<std::array<real_type,2>, N> stencil_weights;
+    /// Find the interpolation stencils at the given tuple of values. Returns false, if some value can't be interpolated by its grid.
+    static bool find_stencils(arg_tuple const& in, const grid_tuple_type& grids, stencil_indices& idx, stencil_weights& w) 
+        { return find_stencils_(index_gen(), in, grids, idx, w); }
     /// Shift a tuple of grid::point to the right (if possible) 
     static point_tuple shift(point_tuple const& in, point_tuple const& shift, const grid_tuple_type& grids) { return shift_(index_gen(), in, shift, grids); }
     static point_tuple shift(point_tuple const& in, arg_tuple const& shift, const grid_tuple_type& grids) { return shift_(index_gen(), in, shift, grids); }
     static arg_tuple shift(arg_tuple const& in, arg_tuple const& shift, const grid_tuple_type& grids) { return shift_(index_gen(), in, shift, grids); }
+    /// For each grid get the indices of its points, shifted by a corresponding value (-1 for points, shifted out of the grid).
+    static index_maps shift_indices(arg_tuple const& shift, const grid_tuple_type& grids) { return shift_indices_(index_gen(), shift, grids); }
 
     static bool is_equal(grid_tuple_type const& g1, grid_tuple_type const& g2) { return is_equal_(index_gen(), g1, g2); }
 
@@ -69,12 +79,17 @@ protected:
         static indices dims_(tuple_tools::extra::arg_seq<S...>, const grid_tuple_type& grids) {return {{ (std::get<S>(grids).size())... }};};
     template <int...S> 
         static point_tuple find_nearest_(tuple_tools::extra::arg_seq<S...>, arg_tuple in, const grid_tuple_type& grids);
+    template <int...S> 
+        static bool find_stencils_(tuple_tools::extra::arg_seq<S...>, arg_tuple const& in, const grid_tuple_type& grids, stencil_indices& idx, stencil_weights& w);
     template <int...S> 
         static point_tuple shift_(tuple_tools::extra::arg_seq<S...>, point_tuple in, point_tuple shift, const grid_tuple_type&grids);
     template <int...S> 
         static point_tuple shift_(tuple_tools::extra::arg_seq<S...>, point_tuple in, arg_tuple shift, const grid_tuple_type&grids);
     template <int...S> 
         static arg_tuple shift_(tuple_tools::extra::arg_seq<S...>, arg_tuple in, arg_tuple shift, const grid_tuple_type&grids);
+    template <int...S> 
+        static index_maps shift_indices_(tuple_tools::extra::arg_seq<S...>, arg_tuple const& shift, const grid_tuple_type& grids)
+            { return {{ (std::get<S>(grids).shift_indices(std::get<S>(shift)))... }}; }
     template <int...S> 
         static bool is_equal_(tuple_tools::extra::arg_seq<S...>, grid_tuple_type const& g1, grid_tuple_type const& g2);
 };
@@ -139,6 +154,15 @@ inline typename grid_tuple_traits<std::tuple<GridTypes...>>::point_tuple
     return out; 
 }
 
+template <typename ...GridTypes>
+template <int...S> 
+inline bool grid_tuple_traits<std::tuple<GridTypes...>>::find_stencils_(
+    tuple_tools::extra::arg_seq<S...>, arg_tuple const& in, const grid_tuple_type& grids, stencil_indices& idx, stencil_weights& w)
+{
+    std::array<bool, N> found = {{ (std::get<S>(grids).interpolation_stencil(std::get<S>(in), idx[S].data(), w[S].data()))... }};
+    return std::all_of(found.begin(), found.end(), [](bool x){return x;});
+}
+
 template <typename ...GridTypes>
 template <int...S> 
 inline typename grid_tuple_traits<std::tuple<GridTypes...>>::point_tuple 
@@ -172,6 +196,7 @@ template <int...S>
 inline bool grid_tuple_traits<std::tuple<GridTypes...>>::is_equal_(
         tuple_tools::extra::arg_seq<S...>, grid_tuple_type const& g1, grid_tuple_type const& g2)
 {
+    if (&g1 == &g2) return true;
     std::array<bool, N> arr = {{ std::get<S>(g1) == std::get<S>(g2) ... }};
     bool ok = true;
     for (size_t i=0; i<N && ok; i++) { ok = ok && arr[i]; }
@@ -40,13 +40,13 @@ T load(alps::hdf5::archive & ar, std::string const & path) { return hdf5_loader<
 // gftools - related
 //
 // load gftools::container
-template <typename T, size_t D>
-struct hdf5_loader<container<T,D>> {
-    typedef container<T,D> type;
-    typedef typename container<T,D>::boost_t boost_type;
+template <typename T, size_t D, typename A>
+struct hdf5_loader<container<T,D,A>> {
+    typedef container<T,D,A> type;
+    typedef typename container<T,D,A>::boost_t boost_type;
     static type load (alps::hdf5::archive & ar, std::string const & path) {
         boost_type c1; ar >> alps::make_pvp(path,c1); return container_ref<T,D>(c1); }
-    static void save (alps::hdf5::archive & ar, std::string const & path, const container<T,D>& c) {
+    static void save (alps::hdf5::archive & ar, std::string const & path, const container<T,D,A>& c) {
         ar << alps::make_pvp(path, c.boost_container_()); }
 };
 
@@ -153,9 +153,9 @@ inline T load_grid_object(alps::hdf5::archive & ar, std::string const & path) {
 
 namespace alps{ 
     namespace hdf5 { 
-        template <typename T, size_t D>
-        inline void save(alps::hdf5::archive & ar, std::string const & path, const gftools::container<T,D>& c) { 
-            gftools::hdf5_loader<gftools::container<T,D>>::save(ar, path, c); }
+        template <typename T, size_t D, typename A>
+        inline void save(alps::hdf5::archive & ar, std::string const & path, const gftools::container<T,D,A>& c) { 
+            gftools::hdf5_loader<gftools::container<T,D,A>>::save(ar, path, c); }
         inline void save(alps::hdf5::archive & ar, std::string const & path, const gftools::enum_grid& x ) { 
             gftools::hdf5_loader<gftools::enum_grid>::save(ar, path, x); }  
         inline void save(alps::hdf5::archive & ar, std::string const & path, const gftools::real_grid& x ) { 
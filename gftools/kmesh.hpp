@@ -31,15 +31,23 @@ public:
     ///The second return value is the index.
     ///The third return value 'weight' measures how close the point is to a grid point
     std::tuple <bool, size_t, real_type> find(real_type in) const ;
+    ///returns the extent of the domain (period) of the kmesh
+    real_type domain_len() const { return domain_len_; }
 
-    template <class Obj> auto integrate(const Obj &in) const -> typename std::result_of<Obj(decltype(vals_[0]))>::type;
+    template <class Obj> auto integrate(const Obj &in) const -> typename std::result_of<Obj(point)>::type;
     template <class Obj> auto eval(Obj &in, real_type x) const ->decltype(in[0]);
     template <class Obj> auto eval(Obj &in, point x) const ->decltype(in[0]) { return base::eval(in,x); }
+    ///same as eval (which finds the nearest point for any x), never fails
+    template <class Obj, typename V> bool try_eval(Obj &in, real_type x, V &out) const { out = in[find_nearest(x).index()]; return true; }
+    ///periodic linear interpolation stencil (see grid_base::interpolation_stencil) : any real x is interpolated
+    bool interpolation_stencil(real_type x, size_t* idx, real_type* w) const;
 
     ///shift implements a periodic operator+ in three variants
     real_type shift(real_type in,real_type shift_arg) const;
     point shift(point in, real_type shift_arg) const { return static_cast<const base*>(this)->shift(in,shift_arg); }
     point shift(point in, point shift_arg) const { return static_cast<const base*>(this)->shift(in,shift_arg); }
+    ///periodic shift of all points as a rotation of indices
+    std::vector<int> shift_indices(real_type shift_arg) const;
 protected:
     ///number of equidistantly spaced points in k-space
     int npoints_;
@@ -85,6 +93,20 @@ inline std::tuple <bool, size_t, real_type> kmesh::find(real_type in) const
 }
 
 
+inline bool kmesh::interpolation_stencil(real_type x, size_t* idx, real_type* w) const
+{
+    if (npoints_ <= 0) return false;
+    real_type t = x/domain_len_*npoints_;
+    // snap to the points of the mesh, so that their values are returned as they are
+    bool on_point = std::abs(t - std::round(t)) < 1e-12 * std::max(1.0, std::abs(t));
+    real_type f = on_point ? std::round(t) : std::floor(t);
+    long i = ((long(f) % npoints_) + npoints_) % npoints_;
+    idx[0] = i; idx[1] = (i+1) % npoints_;
+    w[1] = on_point ? 0.0 : t - f;
+    w[0] = 1.0 - w[1];
+    return true;
+}
+
 template <class Obj>
 inline auto kmesh::eval(Obj &in, real_type x) const ->decltype(in[0])
 {
@@ -93,10 +115,11 @@ inline auto kmesh::eval(Obj &in, real_type x) const ->decltype(in[0])
 }
 
 template <class Obj>
-auto kmesh::integrate(const Obj &in) const -> typename std::result_of<Obj(decltype(vals_[0]))>::type
+auto kmesh::integrate(const Obj &in) const -> typename std::result_of<Obj(point)>::type
 {
-    decltype(in(vals_[0])) R = in(real_type(vals_[0]));
-    R=std::accumulate(vals_.begin()+1, vals_.end(), R,[&](decltype(in(vals_[0]))& y,decltype(vals_[0]) & x) {return y+in(x);});
+    auto pts = this->points();
+    typename std::result_of<Obj(point)>::type R = in(real_type(vals_[0]));
+    R=std::accumulate(pts.begin()+1, pts.end(), R,[&](typename std::result_of<Obj(point)>::type& y, point x) {return y+in(x);});
     return R/npoints_;
 }
 
@@ -109,4 +132,16 @@ inline real_type kmesh::shift(real_type in, real_type shift_arg) const
     return out;
 }
 
+inline std::vector<int> kmesh::shift_indices(real_type shift_arg) const
+{
+    std::vector<int> out(npoints_, -1);
+    real_type n = shift_arg/domain_len_*npoints_;
+    long offset = std::lround(n);
+    // same tolerance as grid_base::shift - a tenth of the spacing
+    if (!almost_equal(n, real_type(offset), 0.1)) return out;
+    offset = ((offset % npoints_) + npoints_) % npoints_;
+    for (int i=0; i<npoints_; ++i) out[i] = (i + offset) % npoints_;
+    return out;
+}
+
 } // end of namespace gftools
@@ -9,6 +9,7 @@ namespace gftools {
 
 struct kmesh_patch : public kmesh 
 {
+    /// index of a point in the parent mesh -> index in the patch
     std::map<size_t,size_t> mapvals_;
 public:
     const kmesh& _parent;
@@ -19,6 +20,11 @@ public:
     kmesh_patch(const kmesh& parent);
     template <class Obj> auto eval(Obj &in, real_type x) const ->decltype(in[0]);
     template <class Obj> auto eval(Obj &in, kmesh::point x) const ->decltype(in[0]);
+    /// same as eval, but returns false instead of throwing, if x is not a point of the patch
+    template <class Obj, typename V> bool try_eval(Obj &in, real_type x, V &out) const;
+    /// only the points of the patch are found (no interpolation), see grid_base::interpolation_stencil
+    bool interpolation_stencil(real_type x, size_t* idx, real_type* w) const;
+    /// index in the patch of a point x of the patch or of the parent mesh
     size_t get_index(kmesh::point x) const;
 };
 
@@ -33,8 +39,8 @@ inline kmesh_patch::kmesh_patch(const kmesh& parent, std::vector<size_t> indices
     _npoints(indices.size())
 {
     for (size_t i=0; i<_npoints; ++i) {
-        vals_[i]=_parent[indices[i]]; 
-        mapvals_[size_t(vals_[i])] = i;
+        vals_[i]=_parent.values()[indices[i]]; 
+        mapvals_[indices[i]] = i;
         }
 }
 
@@ -42,9 +48,9 @@ inline kmesh_patch::kmesh_patch(const kmesh& parent):
     _parent(parent),
     _npoints(parent.size())
 {
-    vals_ = parent.points();
+    vals_ = parent.values();
      for (size_t i=0; i<_npoints; ++i) {
-        mapvals_[size_t(vals_[i])] = i;
+        mapvals_[i] = i;
         }
 }
 
@@ -53,7 +59,16 @@ inline auto kmesh_patch::eval(Obj &in, real_type x) const ->decltype(in[0])
 {
     const auto find_result=_parent.find_nearest(x);
     if (!almost_equal(find_result.value(), x)) throw ex_not_found(x, *this); 
-    return _parent.eval(in, find_result);
+    return this->eval(in, find_result);
+}
+
+template <class Obj, typename V> 
+inline bool kmesh_patch::try_eval(Obj &in, real_type x, V &out) const
+{
+    size_t idx[2]; real_type w[2];
+    if (!this->interpolation_stencil(x, idx, w)) return false;
+    out = in[idx[0]];
+    return true;
 }
 
 template <class Obj> 
@@ -62,8 +77,20 @@ inline auto kmesh_patch::eval(Obj &in, kmesh::point x) const ->decltype(in[0])
     return in[this->get_index(x)];
 }
 
+inline bool kmesh_patch::interpolation_stencil(real_type x, size_t* idx, real_type* w) const
+{
+    const auto p = _parent.find_nearest(x);
+    auto f1 = mapvals_.find(p.index());
+    if (!almost_equal(p.value(), x) || f1 == mapvals_.end()) return false;
+    idx[0] = idx[1] = f1->second; 
+    w[0] = 1.0; w[1] = 0.0;
+    return true;
+}
+
 inline size_t kmesh_patch::get_index(kmesh::point x) const
 {
+    // points of the patch carry the index in the patch
+    if (x.index() < vals_.size() && vals_[x.index()] == x.value()) return x.index();
     auto f1 = mapvals_.find(size_t(x));
     if (f1!=mapvals_.end()) { return f1->second; }
     else throw ex_not_found(x,*this); 
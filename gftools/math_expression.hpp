@@ -1,23 +1,191 @@
 #pragma once
 
 #include <utility>
+#include <array>
+#include <numeric>
+#include <functional>
+#include <type_traits>
+#include <cassert>
 
-namespace gftools { 
+#include <Eigen/Core>
 
+#include "allocator.hpp"
+
+namespace gftools {
+
+template <typename ValueType, size_t N, typename BoostContainerType>
+struct container_base;
+
+template <typename ValueType, size_t N, typename Allocator>
+struct container;
+
+template <typename ValueType, size_t N, size_t D>
+struct flat_eval_expression;
+
+/** Elementwise operations, that are used as an Op parameter of math_expr.
+ * Each of them combines two Eigen array expressions into a new (lazy) Eigen expression. */
+namespace ops {
+struct plus { template <typename L, typename R> static auto apply(L const& l, R const& r) -> decltype(l+r) { return l+r; } };
+struct minus { template <typename L, typename R> static auto apply(L const& l, R const& r) -> decltype(l-r) { return l-r; } };
+struct multiplies { template <typename L, typename R> static auto apply(L const& l, R const& r) -> decltype(l*r) { return l*r; } };
+struct divides { template <typename L, typename R> static auto apply(L const& l, R const& r) -> decltype(l/r) { return l/r; } };
+} // end of namespace ops
+
+/** math_terminal is a leaf of an expression tree. It is a flat read-only view of the memory of a container_base.
+ * It doesn't own the memory, so the container should outlive the expression.
+ */
+template <typename ValueType, size_t N>
+struct math_terminal {
+    /// total rank of the viewed container
+    constexpr static size_t N_ = N;
+    /// typedef for stored values
+    typedef ValueType value_type;
+    /// typedef for a flattened array (Eigen::Array type)
+    typedef Eigen::Array<ValueType, Eigen::Dynamic, 1> EigenArray;
+    /// typedef for a read-only Eigen::Map of the data
+    typedef Eigen::Map<const EigenArray> eigen_type;
+
+    math_terminal(const ValueType* data, std::array<size_t,N> shape):data_(data),shape_(shape){}
+
+    /// returns the shape of the viewed container
+    std::array<size_t,N> shape() const { return shape_; }
+    /// returns the total amount of elements
+    size_t size() const { return std::accumulate(shape_.begin(), shape_.end(), size_t(1), std::multiplies<size_t>()); }
+    /// returns an Eigen::Map over n elements of the data
+    eigen_type eigen(size_t n) const { assert(n == size()); return eigen_type(data_, n); }
+
+    /// pointer to the first element of the viewed container
+    const ValueType* data_;
+    /// shape of the viewed container
+    std::array<size_t,N> shape_;
+};
+
+/** math_scalar is a leaf of an expression tree, that represents a number, broadcasted to the shape of the expression. */
+template <typename ValueType>
+struct math_scalar {
+    /// typedef for stored values
+    typedef ValueType value_type;
+    /// typedef for a flattened array (Eigen::Array type)
+    typedef Eigen::Array<ValueType, Eigen::Dynamic, 1> EigenArray;
+
+    explicit math_scalar(ValueType v):v_(v){}
+    /// returns a constant Eigen array of n elements
+    auto eigen(size_t n) const -> decltype(EigenArray::Constant(n, std::declval<ValueType>())) { return EigenArray::Constant(n, v_); }
+
+    /// the number
+    ValueType v_;
+};
+
+namespace extra {
+/// shape of a binary expression is defined by its non-scalar argument(s)
+template <typename L, typename V>
+auto math_shape(L const& l, math_scalar<V> const&) -> decltype(l.shape()) { return l.shape(); }
+template <typename V, typename R>
+auto math_shape(math_scalar<V> const&, R const& r) -> decltype(r.shape()) { return r.shape(); }
+template <typename L, typename R>
+auto math_shape(L const& l, R const& r) -> decltype(l.shape()) { assert(l.size() == r.size()); (void)r; return l.shape(); }
+} // end of namespace extra
+
+/** math_expr is a node of an expression tree, that represents an elementwise binary operation Op of L and R.
+ * The expression is lazy - no memory is allocated and no arithmetic is done until it is assigned to a container
+ * (or reduced with sum()). The whole tree is then evaluated in a single vectorized pass of Eigen over flattened data.
+ * As with Eigen expressions, math_expr keeps pointers to the data of its arguments, so it should be evaluated
+ * before they go out of scope - avoid storing it with auto.
+ */
 template <typename L, typename Op, typename R>
-struct math_expr { 
+struct math_expr {
+    /// typedef for values of the expression
+    typedef typename L::value_type value_type;
+    /// total rank of the expression
+    constexpr static size_t N_ = std::tuple_size<decltype(extra::math_shape(std::declval<L>(), std::declval<R>()))>::value;
 
-    math_expr(L l, R r):l_(std::forward<L>(l)),r_(std::forward<R>(r)){}
-    math_expr(math_expr const&) = delete;
-    math_expr& operator=(math_expr const&) = delete;
-    math_expr(math_expr&& rhs):l_(std::forward<L>(rhs.l_)),r_(std::forward<R>(rhs.r_)){}
-    math_expr& operator=(math_expr &&) = default;
+    math_expr(L l, R r):l_(l),r_(r){}
 
-    template <typename RHS> 
-    using result_type = math_expr<math_expr<L,Op,R>,Op,RHS&&>; 
+    /// returns the shape of the expression
+    std::array<size_t,N_> shape() const { return extra::math_shape(l_, r_); }
+    /// returns the total amount of elements
+    size_t size() const { auto s = shape(); return std::accumulate(s.begin(), s.end(), size_t(1), std::multiplies<size_t>()); }
+    /// returns a (lazy) Eigen expression of n elements
+    auto eigen(size_t n) const -> decltype(Op::apply(std::declval<L const&>().eigen(n), std::declval<R const&>().eigen(n)))
+        { return Op::apply(l_.eigen(n), r_.eigen(n)); }
 
+    /// sum of all values of the expression (no temporary is created)
+    value_type sum() const { return this->eigen(this->size()).sum(); }
+    /// evaluate the expression into a new container
+    container<value_type,N_> eval() const { return container<value_type,N_>(*this); }
+
+    /// left argument
     L l_;
+    /// right argument
     R r_;
 };
 
+namespace extra {
+/// convert an argument of an arithmetic operation to a node of an expression tree
+template <typename V, size_t N, typename BC>
+math_terminal<V,N> make_math_node(container_base<V,N,BC> const& in) { return math_terminal<V,N>(in.data(), in.shape()); }
+template <typename V, size_t N, size_t D>
+math_terminal<V,D> make_math_node(flat_eval_expression<V,N,D> const& in) { return math_terminal<V,D>(in.data(), in.shape()); }
+template <typename L, typename Op, typename R>
+math_expr<L,Op,R> make_math_node(math_expr<L,Op,R> const& in) { return in; }
+
+template <typename T> struct math_void { typedef void type; };
+} // end of namespace extra
+
+/// math_node defines a type of the node of expression tree for a container or an expression (and nothing otherwise)
+template <typename T, typename = void>
+struct math_node {};
+template <typename T>
+struct math_node<T, typename extra::math_void<decltype(extra::make_math_node(std::declval<T const&>()))>::type> { 
+    typedef decltype(extra::make_math_node(std::declval<T const&>())) type; };
+
+/// is_math_operand is true_type for containers and expressions
+template <typename T, typename = void>
+struct is_math_operand : std::false_type {};
+template <typename T>
+struct is_math_operand<T, typename extra::math_void<typename math_node<T>::type>::type> : std::true_type {};
+
+/// is_math_scalar_of is true_type if S is a number, that can be combined with a container or an expression T
+template <typename S, typename T, bool = is_math_operand<T>::value>
+struct is_math_scalar_of : std::false_type {};
+template <typename S, typename T>
+struct is_math_scalar_of<S,T,true> : std::integral_constant<bool,
+    !is_math_operand<S>::value && std::is_convertible<S, typename math_node<T>::type::value_type>::value> {};
+
+/// is_math_pair is true_type if L and R are containers or expressions with the same value_type
+template <typename L, typename R, bool = is_math_operand<L>::value && is_math_operand<R>::value>
+struct is_math_pair : std::false_type {};
+template <typename L, typename R>
+struct is_math_pair<L,R,true> : std::is_same<typename math_node<L>::type::value_type, typename math_node<R>::type::value_type> {};
+
+/// Elementwise arithmetic operators for containers, expressions and numbers. Each returns a math_expr.
+#define GFTOOLS_MATH_EXPR_OPERATOR(OPERATOR, OP)                                                                         \
+template <typename L, typename R>                                                                                        \
+typename std::enable_if<is_math_pair<L,R>::value,                                                                        \
+    math_expr<typename math_node<L>::type, OP, typename math_node<R>::type>>::type                                       \
+OPERATOR(const L& l, const R& r)                                                                                         \
+{ return math_expr<typename math_node<L>::type, OP, typename math_node<R>::type>(                                        \
+    extra::make_math_node(l), extra::make_math_node(r)); }                                                               \
+template <typename L, typename R>                                                                                        \
+typename std::enable_if<is_math_scalar_of<R,L>::value,                                                                   \
+    math_expr<typename math_node<L>::type, OP, math_scalar<typename math_node<L>::type::value_type>>>::type              \
+OPERATOR(const L& l, const R& r)                                                                                         \
+{ typedef typename math_node<L>::type::value_type value_type;                                                            \
+  return math_expr<typename math_node<L>::type, OP, math_scalar<value_type>>(                                            \
+    extra::make_math_node(l), math_scalar<value_type>(value_type(r))); }                                                 \
+template <typename L, typename R>                                                                                        \
+typename std::enable_if<is_math_scalar_of<L,R>::value,                                                                   \
+    math_expr<math_scalar<typename math_node<R>::type::value_type>, OP, typename math_node<R>::type>>::type              \
+OPERATOR(const L& l, const R& r)                                                                                         \
+{ typedef typename math_node<R>::type::value_type value_type;                                                            \
+  return math_expr<math_scalar<value_type>, OP, typename math_node<R>::type>(                                            \
+    math_scalar<value_type>(value_type(l)), extra::make_math_node(r)); }
+
+GFTOOLS_MATH_EXPR_OPERATOR(operator+, ops::plus)
+GFTOOLS_MATH_EXPR_OPERATOR(operator-, ops::minus)
+GFTOOLS_MATH_EXPR_OPERATOR(operator*, ops::multiplies)
+GFTOOLS_MATH_EXPR_OPERATOR(operator/, ops::divides)
+
+#undef GFTOOLS_MATH_EXPR_OPERATOR
+
 } // end of namespace gftools
@@ -64,9 +64,11 @@ public:
     point find_nearest(complex_type in) const;
 
     ///TODO: remove C++-11
-    template <class Obj> auto integrate(const Obj &in) const -> decltype(in(vals_[0]));
-    template <class Obj> auto prod(const Obj &in) const -> decltype(in(vals_[0]));
+    template <class Obj> auto integrate(const Obj &in) const -> decltype(in(std::declval<point>()));
+    template <class Obj> auto prod(const Obj &in) const -> decltype(in(std::declval<point>()));
     template <class Obj> auto eval(Obj &in, complex_type x) const ->decltype(in[0]);
+    ///same as eval, but returns false instead of throwing, if x is not a frequency of the grid
+    template <class Obj, typename V> bool try_eval(Obj &in, complex_type x, V &out) const;
 protected:
     /** Inverse temperature. */
     const real_type beta_;
@@ -101,20 +103,22 @@ matsubara_grid<F>::matsubara_grid(std::vector<complex_type> const& in):
 
 template <bool F>
 template <class Obj> 
-auto matsubara_grid<F>::integrate(const Obj &in) const -> decltype(in(vals_[0]))
+auto matsubara_grid<F>::integrate(const Obj &in) const -> decltype(in(std::declval<point>()))
 {
-    decltype(in(this->vals_[0])) R = in(this->vals_[0]);
-    R=std::accumulate(vals_.begin()+1, vals_.end(), R,[&](decltype(in(vals_[0]))& y,decltype(vals_[0]) &x) {return y+in(x);}); 
+    auto pts = this->points();
+    decltype(in(std::declval<point>())) R = in(pts[0]);
+    R=std::accumulate(pts.begin()+1, pts.end(), R,[&](decltype(in(std::declval<point>()))& y,point x) {return y+in(x);}); 
     return R/beta_;
 }
 
 template <bool F>
 template <class Obj> 
-auto matsubara_grid<F>::prod(const Obj &in) const -> decltype(in(vals_[0]))
+auto matsubara_grid<F>::prod(const Obj &in) const -> decltype(in(std::declval<point>()))
 {
     // fix prod for more numerical stability
-    decltype(in(vals_[0])) R = in(vals_[0]);
-    R=std::accumulate(vals_.begin()+1, vals_.end(), R,[&](decltype(in(vals_[0]))& y,decltype(vals_[0]) &x) {return y*in(x);}); 
+    auto pts = this->points();
+    decltype(in(std::declval<point>())) R = in(pts[0]);
+    R=std::accumulate(pts.begin()+1, pts.end(), R,[&](decltype(in(std::declval<point>()))& y,point x) {return y*in(x);}); 
     return R;
 }
 
@@ -123,11 +127,11 @@ inline typename matsubara_grid<F>::point matsubara_grid<F>::find_nearest (comple
 {
     int n=MatsubaraIndex<F>(in, beta_);
     if (n>=w_min_ && n<w_max_) { 
-      return vals_[n-w_min_]; 
+      return (*this)[n-w_min_]; 
     }
     else { 
-      if (n<w_min_) return vals_[0];
-      else return vals_[vals_.size()-1];
+      if (n<w_min_) return (*this)[0];
+      else return (*this)[vals_.size()-1];
     }
 }
 
@@ -140,4 +144,14 @@ inline auto matsubara_grid<F>::eval(Obj &in, complex_type x) const ->decltype(in
     return in[find_result.index()];
 }
 
+template <bool F>
+template <class Obj, typename V>
+inline bool matsubara_grid<F>::try_eval(Obj &in, complex_type x, V &out) const
+{
+    const auto find_result=this->find_nearest(x);
+    if (!almost_equal(x,find_result.value())) return false;
+    out = in[find_result.index()];
+    return true;
+}
+
 } // end of namespace gftools
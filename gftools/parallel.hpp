@@ -0,0 +1,324 @@
+#pragma once
+
+/// \file : parallel.hpp
+/// Opt-in parallel loops and deterministic reductions, used by containers and grid_objects for large arrays.
+/// The backend is chosen at compile time with the CMake option Parallel :
+///  - OpenMP  : defines GFTOOLS_USE_OPENMP, loops are run in OpenMP parallel regions
+///  - Threads : defines GFTOOLS_USE_THREADS, loops are run by a built-in work-stealing scheduler over std::threads
+/// Without either of these definitions everything runs serially, exactly as before.
+/// Arrays smaller than threshold() are always processed serially.
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <vector>
+
+#if defined(GFTOOLS_USE_THREADS)
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#elif defined(GFTOOLS_USE_OPENMP)
+#include <omp.h>
+#endif
+
+namespace gftools {
+namespace parallel {
+
+/// size of a cache line in bytes : chunks of arrays, that are written in parallel, start at cache line boundaries
+constexpr size_t cache_line = 64;
+/// number of elements in a chunk of a reduction. Doesn't depend on the number of threads, so that reductions are reproducible.
+constexpr size_t reduce_chunk = 4096;
+
+/// true, if a parallel backend is compiled in
+constexpr bool enabled()
+{
+#if defined(GFTOOLS_USE_THREADS) || defined(GFTOOLS_USE_OPENMP)
+    return true;
+#else
+    return false;
+#endif
+}
+
+namespace extra {
+inline std::atomic<int>& num_threads_() { static std::atomic<int> n(0); return n; }
+inline std::atomic<size_t>& threshold_() { static std::atomic<size_t> n(size_t(1) << 15); return n; }
+/// true in a thread, that runs a task
+inline bool& in_task_() { static thread_local bool t = false; return t; }
+} // end of namespace extra
+
+/// true, if parallel loops called from tasks (nested loops) run in parallel : the Threads backend shares its workers between
+/// all levels, the OpenMP backend runs nested loops serially
+constexpr bool nested_parallelism()
+{
+#if defined(GFTOOLS_USE_THREADS)
+    return true;
+#else
+    return false;
+#endif
+}
+/// true in a task of a parallel loop
+inline bool in_task() { return extra::in_task_(); }
+
+/// number of threads of the parallel loops (1 without a backend)
+inline int num_threads()
+{
+    if (!enabled()) return 1;
+    int n = extra::num_threads_().load();
+    if (n > 0) return n;
+#if defined(GFTOOLS_USE_THREADS)
+    return std::max(1u, std::thread::hardware_concurrency());
+#elif defined(GFTOOLS_USE_OPENMP)
+    return omp_get_max_threads();
+#else
+    return 1;
+#endif
+}
+/// set the number of threads of the parallel loops (0 : all hardware threads)
+inline void set_num_threads(int n) { extra::num_threads_() = std::max(n, 0); }
+
+/// arrays with less elements are processed serially
+inline size_t threshold() { return extra::threshold_().load(); }
+inline void set_threshold(size_t n) { extra::threshold_() = n; }
+
+/// true, if a loop over n elements should run in parallel
+inline bool use_parallel(size_t n) 
+    { return enabled() && n >= threshold() && num_threads() > 1 && (nested_parallelism() || !extra::in_task_()); }
+
+#if defined(GFTOOLS_USE_THREADS)
+namespace extra {
+/** The work-stealing task scheduler of the Threads backend. 
+ * A parallel loop is a job of ntasks tasks, that starts as one range of tasks and is split in halves by the thread, that runs it. 
+ * Every worker owns a deque of ranges : it takes its newest range from the back, idle workers steal the oldest (largest) ranges 
+ * from the front of the other deques. A thread, that waits for a job, runs tasks as well, so loops called from tasks (nested loops) 
+ * are spread over the same workers instead of starting new threads. When there are no tasks left to take, it sleeps until the job 
+ * is done, so waiting threads don't take cores from other thread or MPI layers. There are at most num_threads()-1 active workers. */
+class task_scheduler {
+public:
+    static task_scheduler& instance() { static task_scheduler scheduler; return scheduler; }
+    ~task_scheduler()
+    {
+        { std::lock_guard<std::mutex> lock(sleep_mutex_); stop_ = true; }
+        wake_.notify_all();
+        for (auto& w : workers_) w.join();
+    }
+
+    /// run f(task) for all tasks < ntasks with nthreads-1 workers and the calling thread, rethrows the first exception of f
+    void run(size_t ntasks, int nthreads, std::function<void(size_t)> const& f)
+    {
+        activate_(nthreads - 1);
+        job j(f, ntasks);
+        push_(task(&j, 0, ntasks));
+        while (j.remaining.load(std::memory_order_acquire) != 0) {
+            task t;
+            if (!take_(t)) break;
+            execute_(t);
+            }
+        // the last tasks run in other threads
+        { std::unique_lock<std::mutex> lock(j.done_mutex); j.done.wait(lock, [&](){ return j.finished; }); }
+        if (j.error) std::rethrow_exception(j.error);
+    }
+
+protected:
+    struct job {
+        job(std::function<void(size_t)> const& f, size_t n):f(f),remaining(n){}
+        std::function<void(size_t)> const& f;
+        std::atomic<size_t> remaining;
+        std::mutex error_mutex;
+        std::exception_ptr error;
+        /// set by the last task
+        bool finished = false;
+        std::mutex done_mutex;
+        std::condition_variable done;
+    };
+    struct task {
+        task(job* j = nullptr, size_t b = 0, size_t e = 0):j(j),begin(b),end(e){}
+        job* j;
+        size_t begin, end;
+    };
+    struct task_queue {
+        std::mutex mutex;
+        std::deque<task> tasks;
+    };
+
+    task_scheduler():max_workers_(std::max(64u, 4*std::thread::hardware_concurrency())), queues_(max_workers_ + 1) {}
+    /// index of the queue of the calling thread : its worker index, or the shared queue of all other threads
+    size_t own_queue_() const { int id = worker_id_(); return id >= 0 ? size_t(id) : max_workers_; }
+    static int& worker_id_() { static thread_local int id = -1; return id; }
+
+    void activate_(int nworkers)
+    {
+        nworkers = std::max(0, std::min(nworkers, int(max_workers_)));
+        if (nworkers != active_.load()) {
+            std::lock_guard<std::mutex> lock(sleep_mutex_);
+            while (int(workers_.size()) < nworkers) { 
+                workers_.emplace_back(&task_scheduler::worker_, this, int(workers_.size()));
+                nstarted_.store(workers_.size());
+                }
+            active_.store(nworkers);
+            }
+    }
+    void push_(task const& t)
+    {
+        task_queue& q = queues_[own_queue_()];
+        { std::lock_guard<std::mutex> lock(q.mutex); q.tasks.push_back(t); }
+        ++queued_;
+        if (sleeping_.load() > 0) { std::lock_guard<std::mutex> lock(sleep_mutex_); wake_.notify_one(); }
+    }
+    /// take the newest task of the own queue or steal the oldest task of another one
+    bool take_(task& t)
+    {
+        if (queued_.load() == 0) return false;
+        const size_t own = own_queue_(), nworkers = nstarted_.load();
+        {
+            task_queue& q = queues_[own];
+            std::lock_guard<std::mutex> lock(q.mutex);
+            if (!q.tasks.empty()) { t = q.tasks.back(); q.tasks.pop_back(); --queued_; return true; }
+        }
+        for (size_t k = 1; k <= nworkers; ++k) { 
+            // the other workers, then the shared queue
+            size_t v = (own == max_workers_) ? (k - 1) : (own + k) % (nworkers + 1);
+            if (v == nworkers) v = max_workers_;
+            if (v == own) continue;
+            task_queue& q = queues_[v];
+            std::lock_guard<std::mutex> lock(q.mutex);
+            if (!q.tasks.empty()) { t = q.tasks.front(); q.tasks.pop_front(); --queued_; return true; }
+            }
+        return false;
+    }
+    /// split the range of tasks in halves (pushing the upper halves), then run the first task
+    void execute_(task t)
+    {
+        while (t.end - t.begin > 1) { 
+            size_t mid = t.begin + (t.end - t.begin) / 2;
+            push_(task(t.j, mid, t.end));
+            t.end = mid;
+            }
+        bool& in_task = in_task_();
+        const bool was_in_task = in_task;
+        in_task = true;
+        try { t.j->f(t.begin); }
+        catch (...) { std::lock_guard<std::mutex> lock(t.j->error_mutex); if (!t.j->error) t.j->error = std::current_exception(); }
+        in_task = was_in_task;
+        // the job may be gone after finished is set
+        if (t.j->remaining.fetch_sub(1, std::memory_order_acq_rel) == 1) { 
+            std::lock_guard<std::mutex> lock(t.j->done_mutex); 
+            t.j->finished = true; 
+            t.j->done.notify_all(); 
+            }
+    }
+    void worker_(int id)
+    {
+        worker_id_() = id;
+        for (;;) {
+            task t;
+            if (id < active_.load() && take_(t)) { execute_(t); continue; }
+            std::unique_lock<std::mutex> lock(sleep_mutex_);
+            ++sleeping_;
+            wake_.wait(lock, [&](){ return stop_ || (id < active_.load() && queued_.load() > 0); });
+            --sleeping_;
+            if (stop_) return;
+            }
+    }
+
+    const size_t max_workers_;
+    /// queues of the workers and (the last one) of all other threads
+    std::vector<task_queue> queues_;
+    std::vector<std::thread> workers_;
+    std::atomic<size_t> nstarted_ { 0 };
+    std::atomic<int> active_ { 0 };
+    std::atomic<long> queued_ { 0 };
+    std::atomic<int> sleeping_ { 0 };
+    std::mutex sleep_mutex_;
+    std::condition_variable wake_;
+    bool stop_ = false;
+};
+} // end of namespace extra
+#endif
+
+/// run f(task) for all tasks < ntasks with the parallel backend (in order, if there is none)
+template <typename F>
+void run(size_t ntasks, F&& f)
+{
+    if (ntasks == 0) return;
+    int nthreads = (extra::in_task_() && !nested_parallelism()) ? 1 : num_threads();
+    if (nthreads <= 1 || ntasks == 1) { for (size_t t = 0; t < ntasks; ++t) f(t); return; }
+#if defined(GFTOOLS_USE_THREADS)
+    extra::task_scheduler::instance().run(ntasks, nthreads, std::function<void(size_t)>(std::ref(f)));
+#elif defined(GFTOOLS_USE_OPENMP)
+    std::exception_ptr error;
+    #pragma omp parallel for schedule(dynamic,1) num_threads(nthreads)
+    for (long t = 0; t < long(ntasks); ++t) {
+        extra::in_task_() = true;
+        try { f(size_t(t)); }
+        catch (...) {
+            #pragma omp critical (gftools_parallel_error)
+            if (!error) error = std::current_exception();
+            }
+        extra::in_task_() = false;
+        }
+    if (error) std::rethrow_exception(error);
+#endif
+}
+
+/** Split [0, n) into contiguous chunks and call f(begin, end) for each of them in parallel.
+ * The chunk boundaries are on cache line boundaries of data (an array of n elements of T), so that threads don't share cache lines.
+ * Runs f(0, n) in the calling thread, if n is below threshold(). */
+template <typename T, typename F>
+void for_each_chunk(T const* data, size_t n, F&& f)
+{
+    if (!use_parallel(n)) { f(size_t(0), n); return; }
+    const size_t nchunks_max = 4 * size_t(num_threads());
+    // elements before the first cache line boundary
+    size_t head = 0, line = 1;
+    std::uintptr_t address = reinterpret_cast<std::uintptr_t>(data);
+    if (sizeof(T) <= cache_line && cache_line % sizeof(T) == 0 && address % sizeof(T) == 0) {
+        line = cache_line / sizeof(T);
+        head = ((cache_line - address % cache_line) % cache_line) / sizeof(T);
+        }
+    size_t chunk = (n + nchunks_max - 1) / nchunks_max;
+    chunk = (chunk + line - 1) / line * line;
+    // boundaries : 0, head + chunk, head + 2*chunk, ... n
+    size_t nchunks = (n > head) ? (n - head + chunk - 1) / chunk : 1;
+    run(nchunks, [&](size_t c){
+        size_t begin = (c == 0) ? 0 : std::min(n, head + c*chunk);
+        size_t end = std::min(n, head + (c+1)*chunk);
+        if (begin < end) f(begin, end);
+        });
+}
+
+/** Split [0, n) into contiguous ranges (up to 4 per thread) and call f(begin, end) for each of them in parallel.
+ * work is the number of elements, that are processed in total : runs f(0, n) in the calling thread, if it is below threshold(). */
+template <typename F>
+void for_each_range(size_t n, size_t work, F&& f)
+{
+    if (n < 2 || !use_parallel(work)) { f(size_t(0), n); return; }
+    const size_t nranges = std::min(n, 4 * size_t(num_threads()));
+    run(nranges, [&](size_t r){ f(r * n / nranges, (r + 1) * n / nranges); });
+}
+
+/** Deterministic reduction over [0, n) : partial(begin, end) is computed for fixed chunks of reduce_chunk elements (in parallel,
+ * if use_parallel(n), otherwise in order in the calling thread), then the results are combined pairwise in a fixed order 
+ * (((p0+p1)+(p2+p3))+...). The chunks and the order depend only on n, not on the number of threads, threshold(), the backend 
+ * or the nesting of the loop, so the result is bitwise reproducible. Returns partial(0, n), if n fits into one chunk. */
+template <typename R, typename F, typename Op>
+R reduce(size_t n, F&& partial, Op&& combine)
+{
+    if (n <= reduce_chunk) return partial(size_t(0), n);
+    const size_t nchunks = (n + reduce_chunk - 1) / reduce_chunk;
+    // partial results are cache lines apart
+    const size_t pad = std::max<size_t>(1, (cache_line + sizeof(R) - 1) / sizeof(R));
+    std::vector<R> parts(nchunks * pad);
+    auto chunk = [&](size_t c){ parts[c*pad] = partial(c*reduce_chunk, std::min(n, (c+1)*reduce_chunk)); };
+    if (use_parallel(n)) run(nchunks, chunk);
+    else for (size_t c = 0; c < nchunks; ++c) chunk(c);
+    for (size_t w = 1; w < nchunks; w *= 2)
+        for (size_t i = 0; i + w < nchunks; i += 2*w) parts[i*pad] = combine(parts[i*pad], parts[(i+w)*pad]);
+    return parts[0];
+}
+
+} // end of namespace parallel
+} // end of namespace gftools
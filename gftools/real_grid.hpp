@@ -3,16 +3,39 @@
 #include <numeric>
 
 #include "grid_base.hpp"
+#include "spline.hpp"
 #include "almost_equal.hpp"
 #include "tuple_tools.hpp"
 
 namespace gftools { 
 
-/** A grid of real values. Does not need to be uniform. Typical example: Grid for Green's function or self-energy on the real axis.*/
+/** A grid of real values. Does not need to be uniform. Typical example: Grid for Green's function or self-energy on the real axis.
+ * Uniform grids and grids made by logarithmic, tangent and chebyshev carry an analytic inverse of their map from index to value,
+ * so that find (and eval) take O(1) instead of a binary search. Other grids of at least search_buckets_min_size points 
+ * keep a table of buckets of equal width over [min, max], so that find searches only among the few points of one bucket. */
 class real_grid : public grid_base<real_type, real_grid>
 {
     using grid_base<real_type, real_grid>::vals_;
 public:
+    /** Analytic inverse of a grid map : returns a (non-integer) index of a value x. */
+    struct index_map {
+        enum class kind { none, uniform, logarithmic, tangent, chebyshev };
+        kind kind_;
+        /// parameters of the map, see make_* functions
+        real_type a_, b_, c_;
+
+        index_map(kind k = kind::none, real_type a = 0, real_type b = 0, real_type c = 0):kind_(k),a_(a),b_(b),c_(c){}
+        real_type operator()(real_type x) const;
+        /// x_i = a + b*i
+        static index_map make_uniform(real_type a, real_type b) { return index_map(kind::uniform, a, b, 0); }
+        /// x_i = a * exp(b*i)
+        static index_map make_logarithmic(real_type a, real_type b) { return index_map(kind::logarithmic, a, b, 0); }
+        /// x_i = a * tan(b * (i/c - 1))
+        static index_map make_tangent(real_type a, real_type b, real_type c) { return index_map(kind::tangent, a, b, c); }
+        /// x_i = a - b * cos(PI * (i + 1/2) / c)
+        static index_map make_chebyshev(real_type a, real_type b, real_type c) { return index_map(kind::chebyshev, a, b, c); }
+    };
+
     /** Generates a uniform grid.
      * \param[in] min Minimal point
      * \param[in] max Maximal point
@@ -27,6 +50,15 @@ public:
     ///constructs a real grid given a vector of values
     real_grid(const std::vector<real_type>& in);
 
+    /** Generates a logarithmic grid of npoints between min > 0 and max (both included) : x_i = min * (max/min)^(i/(npoints-1)). */
+    static real_grid logarithmic(real_type min, real_type max, size_t npoints);
+    /** Generates a grid between -max and max (both included), which is dense around 0 : x_i = max * tan(c u_i) / tan(c), 
+     * u_i = 2i/(npoints-1) - 1. Larger compression c (0 < c < PI/2) puts more points around 0. */
+    static real_grid tangent(real_type max, size_t npoints, real_type compression = 1.4);
+    /** Generates a grid of Chebyshev nodes (of the first kind) in the interval (min, max) : 
+     * x_i = (min+max)/2 - (max-min)/2 cos(PI (i+1/2) / npoints). */
+    static real_grid chebyshev(real_type min, real_type max, size_t npoints);
+
     ///query the largest point of the grid
     real_type max() const { return max_; }
     ///query the smallest point of the grid
@@ -39,6 +71,24 @@ public:
     std::tuple <bool, size_t, real_type> find(real_type in) const;
 
     template <class Obj> auto eval(Obj &in, real_type x) const -> decltype(std::declval<typename std::remove_reference<decltype(in[0])>::type>()*1.0);
+    ///same as eval, but returns false instead of throwing, if x is out of [min, max]
+    template <class Obj, typename V> bool try_eval(Obj &in, real_type x, V &out) const;
+    ///find for n values at once : index[i] and weight[i] are the same as in find(xs[i]). 
+    ///Sorted xs are found in one walk over the grid. Throws ex_not_found if some of xs is out of bounds.
+    void find_many(const real_type* xs, size_t n, size_t* index, real_type* weight) const;
+    ///linear interpolation (as eval) at n values : out[i] = eval(in, xs[i]), see find_many.
+    template <class Obj, class Out> void eval_many(Obj &in, const real_type* xs, size_t n, Out &&out) const;
+    ///cubic spline (natural or monotone) through the values of in at the points of the grid
+    template <typename V, class Obj> cubic_spline<V> spline(Obj &in, interpolation kind) const 
+        { return make_spline<V>(kind, vals_.data(), in, vals_.size()); }
+    ///linear interpolation stencil (see grid_base::interpolation_stencil), false outside [min, max]
+    bool interpolation_stencil(real_type x, size_t* idx, real_type* w) const;
+    ///spline interpolation of in at x, s is made by spline(in, kind)
+    template <class Obj, typename V> V eval(Obj &in, cubic_spline<V> const& s, real_type x) const;
+    ///same as eval with a spline, but returns false instead of throwing, if x is out of [min, max]
+    template <class Obj, typename V> bool try_eval(Obj &in, cubic_spline<V> const& s, real_type x, V &out) const;
+    ///spline interpolation at n values : out[i] = eval(in, s, xs[i])
+    template <class Obj, typename V, class Out> void eval_many(Obj &in, cubic_spline<V> const& s, const real_type* xs, size_t n, Out &&out) const;
     template <class Obj, typename ...OtherArgTypes> 
         auto integrate(Obj &&in, OtherArgTypes... Args) const -> 
             typename std::remove_reference<typename std::result_of<Obj(value_type,OtherArgTypes...)>::type>::type;
@@ -48,10 +98,20 @@ public:
 
     ///query if a grid is uniform or not.
     bool is_uniform() const{return is_uniform_;}
+    ///query the analytic inverse of the grid map (the kind is none, if there is none)
+    index_map const& map() const{return map_;}
+    ///non-uniform grids of at least that many points get a table of buckets for find
+    static constexpr int search_buckets_min_size = 64;
+    ///query if find uses a table of buckets
+    bool has_search_buckets() const{return !buckets_.empty();}
         
 private:
-    ///check if the grid is a uniform grid
+    ///constructs a real grid given sorted values and the inverse of the map, which generated them
+    real_grid(std::vector<real_type>&& in, index_map const& map);
+    ///check if the grid is a uniform grid (and make the table of buckets if it is not)
     bool check_uniform();
+    ///make the table of buckets
+    void build_buckets_();
     
     ///minimum value of the grid
     real_type min_;
@@ -59,6 +119,12 @@ private:
     real_type max_;
     ///whether the grid is an uniform grid or not
     bool is_uniform_ = false;
+    ///analytic inverse of the map from indices to values
+    index_map map_;
+    ///buckets_[b] is the number of points below min_ + b*bucket_width_ (shared by the copies of the grid)
+    shared_values<int> buckets_;
+    ///width of a bucket
+    real_type bucket_width_ = 0;
 };
 
 
@@ -70,14 +136,15 @@ inline real_grid::real_grid(real_type min, real_type max, size_t n_points, bool
     grid_base<real_type,real_grid>(0,n_points,[n_points,max,min,include_last](size_t in){return (max-min)/(n_points-include_last)*in+min;}),
     min_(min),
     max_((include_last?max:vals_[n_points-1])),
-    is_uniform_(true)
+    is_uniform_(true),
+    map_(index_map::make_uniform(min, (max-min)/(n_points-include_last)))
 {
 }
 
 inline real_grid::real_grid(int min, int max, const std::function<real_type (int)> &f, bool include_last):
     grid_base(min,max+include_last,f),
     min_(f(min)),
-    max_(f(max-include_last))
+    max_(f(max-int(!include_last)))
 {
     check_uniform();
 }
@@ -88,7 +155,7 @@ grid_base<real_type, real_grid>(in)
     auto in2(in);
     std::sort(in2.begin(), in2.end());
     size_t npts = in2.size();
-    for (size_t i=0; i<npts; ++i) vals_[i]=point(in2[i],i);
+    vals_ = in2;
     min_ = in2[0]; max_ = in2[npts-1];
     check_uniform();
 }*/
@@ -96,15 +163,62 @@ grid_base<real_type, real_grid>(in)
 
 inline real_grid::real_grid(const std::vector<real_type>& in)
 {
-    vals_.reserve(in.size());
-    auto in2(in);
-    std::sort(in2.begin(), in2.end());
-    size_t npts = in2.size();
-    for (size_t i=0; i<npts; ++i) vals_.emplace_back(in2[i],i);
-    min_ = in2[0]; max_ = in2[npts-1];
+    vals_ = in;
+    std::sort(vals_.begin(), vals_.end());
+    min_ = vals_[0]; max_ = vals_[vals_.size()-1];
     check_uniform();
 }
 
+inline real_grid::real_grid(std::vector<real_type>&& in, index_map const& map):
+    grid_base<real_type, real_grid>(),
+    min_(in[0]),
+    max_(in[in.size()-1]),
+    map_(map)
+{
+    vals_ = std::move(in);
+}
+
+inline real_grid real_grid::logarithmic(real_type min, real_type max, size_t n_points)
+{
+    if (min <= 0 || max <= min || n_points < 2) throw ex_generic("real_grid::logarithmic : need 0 < min < max and at least 2 points");
+    real_type b = std::log(max/min)/(n_points-1);
+    std::vector<real_type> v(n_points);
+    for (size_t i=0; i<n_points; ++i) v[i] = min*std::exp(b*i);
+    v[n_points-1] = max;
+    return real_grid(std::move(v), index_map::make_logarithmic(min, b));
+}
+
+inline real_grid real_grid::tangent(real_type max, size_t n_points, real_type compression)
+{
+    if (max <= 0 || n_points < 2 || compression <= 0 || compression >= M_PI/2) 
+        throw ex_generic("real_grid::tangent : need max > 0, 0 < compression < PI/2 and at least 2 points");
+    real_type a = max/std::tan(compression), c = (n_points-1)/2.;
+    std::vector<real_type> v(n_points);
+    for (size_t i=0; i<n_points; ++i) v[i] = a*std::tan(compression*(i/c - 1.));
+    v[0] = -max; v[n_points-1] = max;
+    return real_grid(std::move(v), index_map::make_tangent(a, compression, c));
+}
+
+inline real_grid real_grid::chebyshev(real_type min, real_type max, size_t n_points)
+{
+    if (max <= min || n_points < 2) throw ex_generic("real_grid::chebyshev : need min < max and at least 2 points");
+    real_type a = (min+max)/2., b = (max-min)/2.;
+    std::vector<real_type> v(n_points);
+    for (size_t i=0; i<n_points; ++i) v[i] = a - b*std::cos(M_PI*(i+0.5)/n_points);
+    return real_grid(std::move(v), index_map::make_chebyshev(a, b, n_points));
+}
+
+inline real_type real_grid::index_map::operator()(real_type x) const
+{
+    switch (kind_) {
+        case kind::uniform: return (x-a_)/b_;
+        case kind::logarithmic: return std::log(x/a_)/b_;
+        case kind::tangent: return c_*(std::atan(x/a_)/b_ + 1.);
+        case kind::chebyshev: return std::acos(std::max(real_type(-1), std::min(real_type(1), (a_-x)/b_)))*c_/M_PI - 0.5;
+        default: return 0;
+        }
+}
+
 
 template <class Obj, typename ...OtherArgTypes> 
 auto real_grid::integrate(Obj &&f, OtherArgTypes... Args) const -> 
@@ -124,11 +238,29 @@ inline bool real_grid::check_uniform()
 { 
     is_uniform_= true; 
     for (int i=0; i<int(vals_.size())-2 && is_uniform_; i++) { 
-        is_uniform_= is_uniform_ && almost_equal(vals_[i+2].value()-vals_[i+1].value(), vals_[i+1].value() - vals_[i].value());
+        is_uniform_= is_uniform_ && almost_equal(vals_[i+2]-vals_[i+1], vals_[i+1] - vals_[i]);
         }
+    if (is_uniform_ && vals_.size() > 1) map_ = index_map::make_uniform(vals_[0], (vals_[vals_.size()-1] - vals_[0])/(vals_.size()-1));
+    else build_buckets_();
     return is_uniform();
 }
 
+inline void real_grid::build_buckets_()
+{
+    buckets_.clear();
+    int n = vals_.size();
+    if (n < search_buckets_min_size || !(max_ > min_)) return;
+    // one bucket per interval on average
+    int nb = n - 1;
+    bucket_width_ = (max_ - min_) / nb;
+    buckets_.resize(nb + 1);
+    for (int b = 0, i = 0; b <= nb; ++b) {
+        real_type x = min_ + b*bucket_width_;
+        while (i < n && vals_[i] < x) ++i;
+        buckets_[b] = i;
+        }
+}
+
 template <class Obj>// decltype (std::declval<Obj>()[0])>
     auto real_grid::integrate(Obj &&v) const -> 
         typename std::remove_reference<decltype (std::declval<Obj>()[0])>::type 
@@ -139,12 +271,12 @@ template <class Obj>// decltype (std::declval<Obj>()[0])>
     R s = 0.0;
     if (!is_uniform_ || n<8) {
         //DEBUG("Using trapezoidal integration");
-        for (int i=0; i<n-1; i++) s+=(v[i+1] + v[i])*(vals_[i+1].value() - vals_[i].value());
+        for (int i=0; i<n-1; i++) s+=(v[i+1] + v[i])*(vals_[i+1] - vals_[i]);
         return 0.5*s;
         }
     //DEBUG("Using simpson");
     for (int i=4;i<n-4;i++) { s += 48.*v[i]; }
-    auto dx = vals_[1].value() - vals_[0].value();
+    auto dx = vals_[1] - vals_[0];
     return dx/48.*(17.*v[0] + 59.*v[1] + 43.*v[2]+49.*v[3] + s + 49. *v[n-4] + 43.*v[n-3] + 59.*v[n-2] + 17.*v[n-1]);
 }
 
@@ -156,22 +288,114 @@ inline std::tuple <bool, size_t, real_type> real_grid::find(real_type in) const
     #endif
     if (in<min_) { ERROR("Point to find is out of bounds, " << in << "<" << min_ ); return std::make_tuple(0,0,0); };
     if (in>max_) { ERROR("Point to find is out of bounds, " << in << ">" << max_ ); return std::make_tuple(0,vals_.size(),0); };
-    auto out = std::lower_bound (vals_.begin(), vals_.end(), in);
-    size_t i = size_t(out-vals_.begin());
-    if (i==0) return std::make_tuple(1,0,1.0);
-    i--;
-    if (i==vals_.size()-1) return std::make_tuple(1,i,1.0);
+    int n = vals_.size();
+    if (n < 2) return std::make_tuple(1,0,0.0);
+    // i is the interval with vals_[i] < in <= vals_[i+1] (or 0)
+    int i;
+    if (map_.kind_ != index_map::kind::none) { 
+        real_type t = map_(in);
+        i = (t > 0) ? std::min(int(t), n-2) : 0;
+        }
+    else { 
+        auto first = vals_.begin(), last = vals_.end();
+        if (!buckets_.empty()) { 
+            int b = std::min(int((in - min_)/bucket_width_), int(buckets_.size()) - 2);
+            first += buckets_[b];
+            last = vals_.begin() + std::min(buckets_[b+1] + 1, n);
+            }
+        i = int(std::lower_bound (first, last, in) - vals_.begin());
+        i = std::min(std::max(i-1, 0), n-2);
+        }
+    // correct for the rounding of the map or of the bucket
+    while (i > 0 && vals_[i] >= in) --i;
+    while (i < n-2 && vals_[i+1] < in) ++i;
     real_type val_i = vals_[i];
     real_type weight=(in-val_i)/(vals_[i+1] - val_i);
     return std::make_tuple (1,i,weight);
 }
 
 
+inline bool real_grid::interpolation_stencil(real_type x, size_t* idx, real_type* w) const
+{
+    if (!(x >= min_ && x <= max_)) return false;
+    auto f = this->find(x);
+    size_t i = std::get<1>(f);
+    idx[0] = i; idx[1] = std::min(i+1, vals_.size()-1);
+    w[1] = std::get<2>(f); w[0] = 1.0 - w[1];
+    return true;
+}
+
+inline void real_grid::find_many(const real_type* xs, size_t n, size_t* index, real_type* weight) const
+{
+    int npts = vals_.size();
+    int i = 0;
+    for (size_t k=0; k<n; ++k) {
+        real_type x = xs[k];
+        if (x<min_ || x>max_) throw ex_not_found(x,*this);
+        if (npts < 2) { index[k] = 0; weight[k] = 0.0; continue; }
+        if (k > 0 && x < xs[k-1]) i = std::get<1>(this->find(x));
+        else if (i < npts-2 && vals_[i+1] < x) { 
+            // vals_[i] < x <= vals_[i+1] holds for the previous x. Find the new interval by galloping forward.
+            int lo = i+1, step = 1;
+            while (lo + step < npts-1 && vals_[lo+step] < x) { lo += step; step *= 2; }
+            int hi = std::min(lo + step, npts-1);
+            i = int(std::lower_bound(vals_.begin() + lo, vals_.begin() + hi + 1, x) - vals_.begin()) - 1;
+            i = std::min(i, npts-2);
+            }
+        index[k] = i;
+        weight[k] = (x-vals_[i])/(vals_[i+1] - vals_[i]);
+        }
+}
+
+template <class Obj, class Out>
+inline void real_grid::eval_many(Obj &in, const real_type* xs, size_t n, Out &&out) const
+{
+    // find and interpolate in chunks, that stay in cache
+    const size_t chunk = 256;
+    size_t index[chunk];
+    real_type weight[chunk];
+    for (size_t k0=0; k0<n; k0+=chunk) {
+        size_t m = std::min(chunk, n-k0);
+        this->find_many(xs + k0, m, index, weight);
+        for (size_t k=0; k<m; ++k) out[k0+k] = in[index[k]] + (in[index[k]+1] - in[index[k]])*weight[k];
+        }
+}
+
+template <class Obj, typename V>
+inline V real_grid::eval(Obj &in, cubic_spline<V> const& s, real_type x) const
+{
+    V out;
+    if (!this->try_eval(in, s, x, out)) throw ex_not_found(x,*this); 
+    return out;
+}
+
+template <class Obj, typename V>
+inline bool real_grid::try_eval(Obj &in, cubic_spline<V> const& s, real_type x, V &out) const
+{
+    if (!(x >= min_ && x <= max_)) return false;
+    size_t i = std::get<1>(this->find(x));
+    out = s(in, i, x - vals_[i]);
+    return true;
+}
+
+template <class Obj, typename V, class Out>
+inline void real_grid::eval_many(Obj &in, cubic_spline<V> const& s, const real_type* xs, size_t n, Out &&out) const
+{
+    const size_t chunk = 256;
+    size_t index[chunk];
+    real_type weight[chunk];
+    for (size_t k0=0; k0<n; k0+=chunk) {
+        size_t m = std::min(chunk, n-k0);
+        this->find_many(xs + k0, m, index, weight);
+        for (size_t k=0; k<m; ++k) out[k0+k] = s(in, index[k], xs[k0+k] - vals_[index[k]]);
+        }
+}
+
 template <class Obj>
 inline auto real_grid::eval(Obj &in, real_type x) const -> decltype(std::declval<typename std::remove_reference<decltype(in[0])>::type>()*1.0)
 {
+    if (!(x >= min_ && x <= max_)) throw ex_not_found(x,*this); 
     const auto find_result=this->find(x);
-    if (!std::get<0>(find_result)) throw ex_not_found(x,*this); 
 // linear spline
     auto prev_index = std::get<1>(find_result);
     auto prevval_ue = in[prev_index];
@@ -189,4 +413,18 @@ inline auto real_grid::eval(Obj &in, real_type x) const -> decltype(std::declval
 */
 }
 
+template <class Obj, typename V>
+inline bool real_grid::try_eval(Obj &in, real_type x, V &out) const
+{
+    // checked here, so that find neither fails nor logs
+    if (!(x >= min_ && x <= max_)) return false;
+    const auto find_result=this->find(x);
+    size_t i = std::get<1>(find_result);
+    out = in[i] + (in[i+1] - in[i])*std::get<2>(find_result);
+    return true;
+}
+
+/// real_grid provides spline interpolation
+template <> struct grid_has_spline<real_grid> : std::true_type {};
+
 } // end of namespace gftools
@@ -0,0 +1,174 @@
+#pragma once
+
+/// \file : spline.hpp
+/// Piecewise cubic interpolation (natural and monotone cubic splines) of values on a grid of real points.
+
+#include <atomic>
+#include <cmath>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <type_traits>
+#include <vector>
+
+#include "defaults.hpp"
+
+namespace gftools {
+
+/// Interpolation between the points of a grid
+enum class interpolation { linear, cubic_spline, monotone_cubic };
+
+/** Coefficients of a piecewise cubic through values y[i] at points x[i] :
+ * between x[i] and x[i+1] the value is y[i] + b[i] t + c[i] t^2 + d[i] t^3, t = x - x[i]. */
+template <typename V>
+struct cubic_spline {
+    std::vector<V> b, c, d;
+    /// value at x[i] + t
+    template <class Obj> V operator()(Obj const& y, size_t i, real_type t) const { return V(y[i]) + t*(b[i] + t*(c[i] + t*d[i])); }
+};
+
+namespace extra {
+/// Fritsch-Butland tangent at an inner point from the slopes d0, d1 of the intervals of widths h0, h1 (0 at extrema)
+inline real_type monotone_tangent(real_type d0, real_type d1, real_type h0, real_type h1)
+{
+    if (d0 * d1 <= 0) return 0;
+    return 3.*(h0 + h1) / ((2.*h1 + h0)/d0 + (h1 + 2.*h0)/d1);
+}
+/// complex values are made monotone in the real and imaginary parts separately
+inline complex_type monotone_tangent(complex_type d0, complex_type d1, real_type h0, real_type h1)
+{
+    return complex_type(monotone_tangent(d0.real(), d1.real(), h0, h1), monotone_tangent(d0.imag(), d1.imag(), h0, h1));
+}
+} // end of namespace extra
+
+/// natural cubic spline (zero second derivatives at the ends) through (x[i], y[i]), i < n
+template <typename V, class Obj>
+cubic_spline<V> make_natural_spline(const real_type* x, Obj const& y, size_t n)
+{
+    cubic_spline<V> s;
+    if (n < 2) return s;
+    std::vector<real_type> h(n-1);
+    std::vector<V> delta(n-1);
+    for (size_t i=0; i<n-1; ++i) { h[i] = x[i+1] - x[i]; delta[i] = (V(y[i+1]) - V(y[i])) / h[i]; }
+    // second derivatives m from a tridiagonal system (Thomas algorithm), m[0] = m[n-1] = 0
+    std::vector<V> m(n, V(0.0));
+    std::vector<real_type> diag(n, 1.0);
+    std::vector<V> rhs(n, V(0.0));
+    for (size_t i=1; i<n-1; ++i) {
+        real_type w = h[i-1] / diag[i-1];
+        diag[i] = 2.*(h[i-1] + h[i]) - (i > 1 ? w*h[i-1] : 0.);
+        rhs[i] = 6.*(delta[i] - delta[i-1]) - (i > 1 ? w*rhs[i-1] : V(0.0));
+        }
+    for (size_t i=n-2; i>=1; --i) m[i] = (rhs[i] - (i < n-2 ? h[i]*m[i+1] : V(0.0))) / diag[i];
+    s.b.resize(n-1); s.c.resize(n-1); s.d.resize(n-1);
+    for (size_t i=0; i<n-1; ++i) {
+        s.b[i] = delta[i] - h[i]*(2.*m[i] + m[i+1])/6.;
+        s.c[i] = m[i]/2.;
+        s.d[i] = (m[i+1] - m[i])/(6.*h[i]);
+        }
+    return s;
+}
+
+/// monotone (Fritsch-Butland) cubic Hermite spline through (x[i], y[i]), i < n : it doesn't overshoot monotone data
+template <typename V, class Obj>
+cubic_spline<V> make_monotone_spline(const real_type* x, Obj const& y, size_t n)
+{
+    cubic_spline<V> s;
+    if (n < 2) return s;
+    std::vector<real_type> h(n-1);
+    std::vector<V> delta(n-1), m(n);
+    for (size_t i=0; i<n-1; ++i) { h[i] = x[i+1] - x[i]; delta[i] = (V(y[i+1]) - V(y[i])) / h[i]; }
+    m[0] = delta[0]; m[n-1] = delta[n-2];
+    for (size_t i=1; i<n-1; ++i) m[i] = extra::monotone_tangent(delta[i-1], delta[i], h[i-1], h[i]);
+    s.b.resize(n-1); s.c.resize(n-1); s.d.resize(n-1);
+    for (size_t i=0; i<n-1; ++i) {
+        s.b[i] = m[i];
+        s.c[i] = (3.*delta[i] - 2.*m[i] - m[i+1])/h[i];
+        s.d[i] = (m[i] + m[i+1] - 2.*delta[i])/(h[i]*h[i]);
+        }
+    return s;
+}
+
+/// spline of a given kind (cubic_spline or monotone_cubic) through (x[i], y[i]), i < n
+template <typename V, class Obj>
+cubic_spline<V> make_spline(interpolation kind, const real_type* x, Obj const& y, size_t n)
+{
+    return (kind == interpolation::monotone_cubic) ? make_monotone_spline<V>(x, y, n) : make_natural_spline<V>(x, y, n);
+}
+
+/// grid_has_spline<Grid> is true_type for grids, which provide spline(in, kind) and eval(in, spline, x) (see real_grid)
+template <typename Grid> struct grid_has_spline : std::false_type {};
+
+namespace extra {
+/** Kind of interpolation of an object and its lazily built spline. The spline is built by the first reader (get is thread-safe) 
+ * and is rebuilt by the next reader after invalidate(), which the owner calls, when it modifies the data. 
+ * modified() is a cheap invalidate() for element accessors : it does nothing, unless a spline was built since the last change.
+ * Copies keep the kind, but not the spline. */
+template <typename V>
+class spline_cache {
+public:
+    spline_cache() = default;
+    spline_cache(spline_cache const& rhs):kind_(rhs.kind_){}
+    spline_cache& operator=(spline_cache const& rhs) { invalidate(); kind_ = rhs.kind_; return *this; }
+
+    interpolation kind() const { return kind_; }
+    void set_kind(interpolation k) { invalidate(); kind_ = k; }
+    /// the data has changed : the spline is rebuilt by the next get (O(1), nothing is freed)
+    void invalidate() { built_.store(false, std::memory_order_relaxed); generation_.fetch_add(1, std::memory_order_release); }
+    /// the data may change : same as invalidate(), if there is a current spline, otherwise only reads two flags
+    void modified() { if (kind_ != interpolation::linear && built_.load(std::memory_order_relaxed)) invalidate(); }
+    /** Returns the spline, building it with make() if there is none or if it was invalidated since it was built. 
+     * The spline is kept alive by the returned pointer, while it is used. */
+    template <typename F> std::shared_ptr<const cubic_spline<V>> get(F&& make) const
+    {
+        const std::uint64_t generation = generation_.load(std::memory_order_acquire);
+        std::shared_ptr<const entry> e = std::atomic_load(&entry_);
+        if (!e || e->generation != generation) {
+            std::lock_guard<std::mutex> lock(mutex_);
+            e = std::atomic_load(&entry_);
+            if (!e || e->generation != generation) { 
+                e = std::make_shared<const entry>(entry { make(), generation }); 
+                std::atomic_store(&entry_, e); 
+                }
+            built_.store(true, std::memory_order_relaxed);
+            }
+        return std::shared_ptr<const cubic_spline<V>>(e, &e->spline);
+    }
+protected:
+    struct entry {
+        cubic_spline<V> spline;
+        /// generation of the data, that the spline was built from
+        std::uint64_t generation;
+    };
+    interpolation kind_ = interpolation::linear;
+    std::atomic<std::uint64_t> generation_ { 0 };
+    /// true, if the spline of the current generation may have been built
+    mutable std::atomic<bool> built_ { false };
+    mutable std::mutex mutex_;
+    mutable std::shared_ptr<const entry> entry_;
+};
+
+/// eval_many of a 1d object with a grid, that has no splines
+template <typename Grid, typename Obj, typename V, typename X>
+void grid_eval_many_(std::false_type, Grid const& grid, Obj const& data, spline_cache<V> const&, const X* xs, size_t n, V* out) 
+    { grid.eval_many(data, xs, n, out); }
+/// eval_many of a 1d object with a linear or spline interpolation
+template <typename Grid, typename Obj, typename V, typename X>
+void grid_eval_many_(std::true_type, Grid const& grid, Obj const& data, spline_cache<V> const& cache, const X* xs, size_t n, V* out)
+{
+    if (cache.kind() == interpolation::linear) grid.eval_many(data, xs, n, out);
+    else grid.eval_many(data, *cache.get([&](){ return grid.template spline<V>(data, cache.kind()); }), xs, n, out);
+}
+/// non-throwing value of a 1d object at x with a grid, that has no splines : false if x isn't found
+template <typename Grid, typename Obj, typename V, typename X>
+bool grid_try_eval_(std::false_type, Grid const& grid, Obj const& data, spline_cache<V> const&, X x, V& out) { return grid.try_eval(data, x, out); }
+/// non-throwing value of a 1d object at x with a linear or spline interpolation : false if x isn't found
+template <typename Grid, typename Obj, typename V, typename X>
+bool grid_try_eval_(std::true_type, Grid const& grid, Obj const& data, spline_cache<V> const& cache, X x, V& out)
+{
+    if (cache.kind() == interpolation::linear) return grid.try_eval(data, x, out);
+    return grid.try_eval(data, *cache.get([&](){ return grid.template spline<V>(data, cache.kind()); }), x, out);
+}
+} // end of namespace extra
+
+} // end of namespace gftools
@@ -0,0 +1,112 @@
+#pragma once
+
+/// \file : workspace.hpp
+/// A scratch arena for the temporaries of iterative calculations. While a workspace is active in a thread (see workspace::scope),
+/// memory of containers and grid_objects, that is freed in this thread, is kept in the workspace, and new containers of the
+/// same size take it back instead of calling malloc and faulting in fresh pages.
+/// Example :
+///     gftools::workspace ws;
+///     for (auto q : qpts) { gftools::workspace::scope s(ws); auto chi = (g * g.shift(q)).conj(); ... }
+///     INFO(ws.stats());
+
+#include <algorithm>
+#include <limits>
+#include <map>
+#include <mutex>
+#include <ostream>
+#include <utility>
+#include <vector>
+
+#include "allocator.hpp"
+
+namespace gftools {
+
+/** A pool of memory blocks for the default allocator of containers (aligned_allocator), that recycles blocks of equal sizes.
+ * The cached blocks are freed by clear() and in the destructor. Blocks, that are taken from a workspace, may outlive it.
+ * A workspace can be active in several threads at once. */
+class workspace : public extra::block_source {
+public:
+    /// statistics of a workspace
+    struct statistics {
+        /// number of allocations, that took a cached block / allocated a new one
+        size_t hits = 0, misses = 0;
+        /// bytes, that were taken from the cache / allocated anew
+        size_t bytes_reused = 0, bytes_allocated = 0;
+        /// bytes in the cache now and at most
+        size_t bytes_cached = 0, peak_bytes_cached = 0;
+    };
+
+    /// Makes a workspace active in the calling thread for the lifetime of the object (the previous one is restored afterwards).
+    /// The workspace should outlive the scope.
+    class scope {
+    public:
+        explicit scope(workspace& w):previous_(extra::current_block_source_()) { extra::current_block_source_() = &w; }
+        ~scope() { extra::current_block_source_() = previous_; }
+        scope(scope const&) = delete;
+        scope& operator=(scope const&) = delete;
+    protected:
+        extra::block_source* previous_;
+    };
+
+    /// a workspace, that caches at most capacity bytes (unlimited by default)
+    explicit workspace(size_t capacity = std::numeric_limits<size_t>::max()):capacity_(capacity){}
+    ~workspace() { clear(); }
+    workspace(workspace const&) = delete;
+    workspace& operator=(workspace const&) = delete;
+
+    /// returns the workspace, that is active in the calling thread (nullptr if there is none)
+    static workspace* current() { return dynamic_cast<workspace*>(extra::current_block_source_()); }
+
+    /// free all cached blocks
+    void clear()
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (auto& blocks : free_) for (void* p : blocks.second) extra::aligned_free(p);
+        free_.clear();
+        stats_.bytes_cached = 0;
+    }
+    /// maximal number of cached bytes : blocks, that don't fit, are freed
+    size_t capacity() const { return capacity_; }
+    void set_capacity(size_t bytes) { std::lock_guard<std::mutex> lock(mutex_); capacity_ = bytes; }
+    statistics stats() const { std::lock_guard<std::mutex> lock(mutex_); return stats_; }
+    /// reset the counters of hits, misses and bytes (keeps the cache)
+    void reset_stats() { std::lock_guard<std::mutex> lock(mutex_); size_t cached = stats_.bytes_cached; stats_ = statistics(); stats_.bytes_cached = stats_.peak_bytes_cached = cached; }
+
+    void* take(size_t bytes, size_t alignment) override
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto it = free_.find(std::make_pair(bytes, alignment));
+        if (it == free_.end() || it->second.empty()) { ++stats_.misses; stats_.bytes_allocated += bytes; return nullptr; }
+        void* p = it->second.back();
+        it->second.pop_back();
+        ++stats_.hits;
+        stats_.bytes_reused += bytes;
+        stats_.bytes_cached -= bytes;
+        return p;
+    }
+    bool give(void* p, size_t bytes, size_t alignment) override
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (bytes > capacity_ - std::min(capacity_, stats_.bytes_cached)) return false;
+        free_[std::make_pair(bytes, alignment)].push_back(p);
+        stats_.bytes_cached += bytes;
+        stats_.peak_bytes_cached = std::max(stats_.peak_bytes_cached, stats_.bytes_cached);
+        return true;
+    }
+
+protected:
+    mutable std::mutex mutex_;
+    /// free blocks by (bytes, alignment)
+    std::map<std::pair<size_t, size_t>, std::vector<void*>> free_;
+    size_t capacity_;
+    statistics stats_;
+};
+
+inline std::ostream& operator<<(std::ostream& out, workspace::statistics const& s)
+{
+    out << "workspace : " << s.hits << " hits, " << s.misses << " misses, " << s.bytes_reused << " bytes reused, "
+        << s.bytes_allocated << " bytes allocated, " << s.bytes_cached << " bytes cached (peak " << s.peak_bytes_cached << ")";
+    return out;
+}
+
+} // end of namespace gftools
@@ -2,6 +2,8 @@
 #include <iostream>
 #include <ctime>
 #include <array>
+#include <cstdint>
+#include <memory>
 #include <functional>
 
 #include "defaults.hpp"
@@ -67,7 +69,7 @@ TEST_F(cont_test, Assignment) {
     EXPECT_DOUBLE_EQ((*d2).sum(), std::accumulate(shape2.begin(), shape2.end(), 1, std::multiplies<int>())*2 );
 
     (*d3) = 1.0;
-    auto a1 = (*d3)[0] - (*d2);
+    container<double,2> a1 = (*d3)[0] - (*d2);
 
     (*d2)+=a1;
 
@@ -90,8 +92,8 @@ TEST_F(cont_test, matrix) {
 TEST_F(cont_test, Math) {
     (*d2) = 2.0;
     (*d3) = 1.0;
-    auto a1 = (*d3)[0] - (*d2);
-    auto a2 = 3.0*(a1+0.5)*2+(*d2);
+    container<double,2> a1 = (*d3)[0] - (*d2);
+    container<double,2> a2 = 3.0*(a1+0.5)*2+(*d2);
 
     EXPECT_DOUBLE_EQ(a2[0][0], -1.);
 
@@ -139,6 +141,96 @@ TEST_F(cont_test, as_matrix) {
 }
 
 
+/// std::allocator, that counts the allocated elements
+template <typename T>
+struct counting_allocator : std::allocator<T> {
+    typedef T value_type;
+    template <typename U> struct rebind { typedef counting_allocator<U> other; };
+    counting_allocator() = default;
+    template <typename U> counting_allocator(counting_allocator<U> const&) {}
+    T* allocate(size_t n) { count() += n; return std::allocator<T>::allocate(n); }
+    void deallocate(T* p, size_t n) { count() -= n; std::allocator<T>::deallocate(p, n); }
+    static long& count() { static long c = 0; return c; }
+};
+
+TEST(ContainerTest, Allocator) {
+    // data of containers is 64 byte aligned by default
+    for (int n : { 1, 3, 17, 1001 }) { 
+        container<double,1> d(n);
+        container<std::complex<double>,2> cd(n, 3);
+        container<int,3> i(n, 2, 5);
+        EXPECT_EQ(reinterpret_cast<std::uintptr_t>(d.data()) % 64, 0u);
+        EXPECT_EQ(reinterpret_cast<std::uintptr_t>(cd.data()) % 64, 0u);
+        EXPECT_EQ(reinterpret_cast<std::uintptr_t>(i.data()) % 64, 0u);
+        EXPECT_EQ(d.sum(), 0.0);
+        }
+
+    // containers with other allocators mix with the default ones
+    {
+        container<double,2,counting_allocator<double>> c(4, 5);
+        EXPECT_EQ(counting_allocator<double>::count(), 20);
+        container<double,2> d(4, 5);
+        for (size_t i = 0; i < 4; ++i) for (size_t j = 0; j < 5; ++j) d[i][j] = i + 0.1*j;
+        c = d;
+        c += d * 2.0;
+        EXPECT_EQ(c.diff(container<double,2>(d * 3.0)), 0.0);
+        container<double,2> e(c);
+        EXPECT_EQ(e.diff(c), 0.0);
+        container<double,2,aligned_allocator<double,256>> f(c * 2.0);
+        EXPECT_EQ(reinterpret_cast<std::uintptr_t>(f.data()) % 256, 0u);
+        EXPECT_EQ(f.diff(container<double,2>(d * 6.0)), 0.0);
+    }
+    EXPECT_EQ(counting_allocator<double>::count(), 0);
+
+    // large blocks are aligned to huge pages
+    size_t threshold = huge_page_threshold();
+    set_huge_page_threshold(1 << 20);
+    container<double,1> small(1000), large(1 << 18);
+    EXPECT_EQ(reinterpret_cast<std::uintptr_t>(large.data()) % huge_page_size, 0u);
+    large[5] = 1.0;
+    EXPECT_EQ(large.sum(), 1.0);
+    set_huge_page_threshold(threshold);
+}
+
+TEST(ContainerTest, Workspace) {
+    const size_t bytes = 30*40*sizeof(double);
+    container<double,2> a(30,40);
+    for (size_t i = 0; i < 30; ++i) for (size_t j = 0; j < 40; ++j) a[i][j] = i - 0.5*j;
+    workspace ws;
+    EXPECT_EQ(workspace::current(), nullptr);
+    {
+        workspace::scope s(ws);
+        EXPECT_EQ(workspace::current(), &ws);
+        for (int i = 0; i < 10; ++i) { 
+            container<double,2> b(a * 2.0);
+            container<double,2> c(b + a);
+            EXPECT_EQ(c.diff(container<double,2>(a * 3.0)), 0.0);
+            }
+        // recycled blocks are zeroed by the containers
+        container<double,2> z(30,40);
+        EXPECT_EQ(z.sum(), 0.0);
+    }
+    EXPECT_EQ(workspace::current(), nullptr);
+    workspace::statistics st = ws.stats();
+    EXPECT_EQ(st.misses, 3u);
+    EXPECT_EQ(st.hits, 28u);
+    EXPECT_EQ(st.bytes_reused, 28*bytes);
+    EXPECT_EQ(st.bytes_allocated, 3*bytes);
+    EXPECT_EQ(st.bytes_cached, 3*bytes);
+    EXPECT_EQ(st.peak_bytes_cached, 3*bytes);
+    std::cout << st << std::endl;
+    ws.clear();
+    EXPECT_EQ(ws.stats().bytes_cached, 0u);
+
+    // blocks above the capacity are freed
+    workspace small(bytes + 1);
+    {
+        workspace::scope s(small);
+        for (int i = 0; i < 3; ++i) container<double,2> b(a * 2.0), c(a * 3.0);
+    }
+    EXPECT_EQ(small.stats().bytes_cached, bytes);
+    EXPECT_EQ(small.stats().hits, 2u);
+}
 
 int main(int argc, char **argv) {
     std::cout << "Hi!" << std::endl;
@@ -101,7 +101,39 @@ TEST(expression3d, container) {
                 ASSERT_EQ(y[i1][i2][i3], e[i1][i2][i3]);
 }
 
+TEST(flat_expression, container) {
+    typedef container<double, 3> data3d;
+    data3d y(4, 3, 5);
+    std::iota(y.data(), y.data() + y.size(), 0.5);
+    static_assert(std::is_same<decltype(y[1]), flat_eval_expression<double,3,2>>::value, "wrong type of operator[]");
+    static_assert(std::is_same<decltype(y[1][2][3]), double&>::value, "wrong type of operator[]");
+    for (size_t i1 = 0; i1 < 4; i1++)
+        for (size_t i2 = 0; i2 < 3; i2++)
+            for (size_t i3 = 0; i3 < 5; i3++)
+                ASSERT_EQ(y[i1][i2][i3], y(std::array<size_t,3>({{i1,i2,i3}})));
+
+    // block operations 
+    auto b = y[2];
+    EXPECT_EQ(b.shape(), (std::array<size_t,2>({{3,5}})));
+    EXPECT_EQ(b.size(), 15);
+    EXPECT_DOUBLE_EQ(b.sum(), b.view().sum());
+    container<double,2> c(b);
+    EXPECT_DOUBLE_EQ(c.diff(b.view()), 0.0);
+    EXPECT_DOUBLE_EQ(y[1][2].sum(), 5.*25 + (0+1+2+3+4) + 0.5*5);
 
+    y[0] = 1.0;
+    EXPECT_DOUBLE_EQ(y[0].sum(), 15.0);
+    y[0] += y[1];
+    EXPECT_DOUBLE_EQ(y[0][1][1], 1.0 + y[1][1][1]);
+    y[3] = y[0] * 2.0;
+    EXPECT_DOUBLE_EQ(y[3][2][4], 2.0*y[0][2][4]);
+    c = y[2];
+    EXPECT_DOUBLE_EQ(c.diff(y[2].view()), 0.0);
+
+    // views of a view
+    y[1][2] = 7.0;
+    EXPECT_DOUBLE_EQ(y[1].view()[2][0], 7.0);
+}
 
 int main(int argc, char **argv) {
     std::cout << "Hi!" << std::endl;
@@ -0,0 +1,367 @@
+#include <numeric>
+
+#include "container.hpp"
+#include "fft.hpp"
+#include "matsubara_grid.hpp"
+#include "kmesh.hpp"
+#include "grid_object.hpp"
+
+#include "gtest/gtest.h"
+
+using namespace gftools;
+
+namespace {
+/// naive fourier transform for comparison
+template <size_t D>
+container<complex_type,D> naive_dft(const container<complex_type,D>& in, int direction)
+{
+    container<complex_type,D> out(in.shape());
+    std::array<size_t,D> shape = in.shape();
+    for (int k = 0; k < in.size(); ++k) {
+        complex_type s = 0.0;
+        for (int j = 0; j < in.size(); ++j) {
+            real_type phase = 0;
+            for (size_t d = 0, kk = k, jj = j, stride = in.size(); d < D; ++d) {
+                stride /= shape[d];
+                phase += real_type((kk / stride) * (jj / stride)) / shape[d];
+                kk %= stride; jj %= stride;
+                }
+            s += in.data()[j] * std::exp(complex_type(0, direction * 2.0 * M_PI * phase));
+            }
+        out.data()[k] = s;
+        }
+    return out;
+}
+
+template <size_t D>
+void fill_data(container<complex_type,D>& in)
+{
+    for (int i = 0; i < in.size(); ++i) in.data()[i] = complex_type(std::cos(0.3*i), std::sin(1.7*i*i) + 0.1*i);
+}
+} // end of anonymous namespace
+
+TEST(fft, transform)
+{
+    container<complex_type,1> a1(8);
+    container<complex_type,2> a2(4,6);
+    container<complex_type,3> a3(2,3,4);
+    container<complex_type,4> a4(2,2,3,2);
+    fill_data(a1); fill_data(a2); fill_data(a3); fill_data(a4);
+
+    EXPECT_NEAR(run_fft(a1, FFTW_FORWARD).diff(naive_dft(a1, FFTW_FORWARD)), 0, 1e-12);
+    EXPECT_NEAR(run_fft(a2, FFTW_FORWARD).diff(naive_dft(a2, FFTW_FORWARD)), 0, 1e-12);
+    EXPECT_NEAR(run_fft(a3, FFTW_FORWARD).diff(naive_dft(a3, FFTW_FORWARD)), 0, 1e-12);
+    EXPECT_NEAR(run_fft(a4, FFTW_FORWARD).diff(naive_dft(a4, FFTW_FORWARD)), 0, 1e-12);
+
+    // backward transform is normalized
+    EXPECT_NEAR(run_fft(run_fft(a2, FFTW_FORWARD), FFTW_BACKWARD).diff(a2), 0, 1e-12);
+    EXPECT_NEAR(run_fft(run_fft(a3, FFTW_BACKWARD), FFTW_FORWARD).diff(a3), 0, 1e-12);
+
+    // results with a given allocator
+    typedef aligned_allocator<complex_type, 256> alloc256;
+    container<complex_type,3,alloc256> f3 = run_fft<alloc256>(a3, FFTW_FORWARD);
+    EXPECT_EQ(reinterpret_cast<std::uintptr_t>(f3.data()) % 256, 0u);
+    EXPECT_EQ(f3.diff(run_fft(a3, FFTW_FORWARD)), 0.0);
+    EXPECT_NEAR(run_fft(f3, FFTW_BACKWARD).diff(a3), 0, 1e-12);
+}
+
+TEST(fft, plan_cache)
+{
+    fft_plan_cache& cache = fft_plan_cache::instance();
+    // small lengths are transformed by FFTW by default
+    EXPECT_FALSE(cache.small_kernels());
+    cache.clear();
+    EXPECT_EQ(cache.size(), 0u);
+
+    container<complex_type,2> a(8,8), b(8,8);
+    fill_data(a); fill_data(b);
+    container<complex_type,2> fa = run_fft(a, FFTW_FORWARD);
+    size_t nplans = cache.size();
+    EXPECT_EQ(nplans, 1u);
+    // same shape and direction reuse the plan
+    for (int i = 0; i < 3; ++i) run_fft(b, FFTW_FORWARD);
+    EXPECT_EQ(cache.size(), nplans);
+    // another direction and shape require new plans
+    run_fft(b, FFTW_BACKWARD);
+    run_fft(container<complex_type,2>(4,8), FFTW_FORWARD);
+    EXPECT_EQ(cache.size(), nplans + 2);
+
+    // a stronger planner doesn't touch the data
+    cache.set_rigor(fft_rigor::measure);
+    container<complex_type,2> fa2 = run_fft(a, FFTW_FORWARD);
+    cache.set_rigor(fft_rigor::estimate);
+    EXPECT_EQ(cache.size(), nplans + 3);
+    EXPECT_NEAR(fa2.diff(fa), 0, 1e-12);
+
+    cache.clear();
+    EXPECT_EQ(cache.size(), 0u);
+    EXPECT_NEAR(run_fft(a, FFTW_FORWARD).diff(fa), 0, 1e-12);
+}
+
+TEST(fft, grid_object_axes)
+{
+    double beta = 10;
+    fmatsubara_grid fgrid(-2,2,beta);
+    kmesh kgrid(4), kgrid2(6);
+    typedef grid_object<complex_type, fmatsubara_grid, kmesh, kmesh> gk_t;
+    gk_t gk(std::make_tuple(fgrid, kgrid, kgrid2));
+    gk.fill([](complex_type w, real_type kx, real_type ky){ return 1.0 / (w - std::cos(kx) - 0.5*std::sin(ky) - 0.1*std::cos(kx+2.*ky)); });
+    gk_t gk0(gk);
+
+    // transform both kmesh axes, batched over frequencies
+    auto gr = run_fft<1,2>(gk, FFTW_BACKWARD);
+    // grids are now lattice sites
+    EXPECT_NEAR(gr.grid<1>()[1].value(), 1.0, 1e-14);
+    EXPECT_NEAR(gr.grid<2>()[5].value(), 5.0, 1e-14);
+    EXPECT_EQ(gr.grid<0>(), fgrid);
+    // data is transformed in place
+    EXPECT_EQ(gr.data().data(), gk.data().data());
+    for (size_t w = 0; w < fgrid.size(); ++w) {
+        container<complex_type,2> slice(gk0[w]), rslice(gr[w]);
+        EXPECT_NEAR(rslice.diff(run_fft(slice, FFTW_BACKWARD)), 0, 1e-12);
+        }
+
+    // and back
+    gk_t gk2 = run_fft<2,1>(gr, FFTW_FORWARD);
+    EXPECT_EQ(gk2.grid<1>(), kgrid);
+    EXPECT_EQ(gk2.grid<2>(), kgrid2);
+    EXPECT_NEAR(gk2.diff(gk0), 0, 1e-12);
+
+    // a single kmesh axis in the middle of the object
+    gk_t gk3(gk0);
+    run_fft<1>(gk3, FFTW_FORWARD);
+    for (size_t w = 0; w < fgrid.size(); ++w) {
+        for (size_t ky = 0; ky < kgrid2.size(); ++ky) {
+            container<complex_type,1> line(kgrid.size());
+            for (size_t kx = 0; kx < kgrid.size(); ++kx) line[kx] = gk0[w][kx][ky];
+            container<complex_type,1> fline = run_fft(line, FFTW_FORWARD);
+            for (size_t x = 0; x < kgrid.size(); ++x) EXPECT_NEAR(std::abs(gk3[w][x][ky] - fline[x]), 0, 1e-12);
+            }
+        }
+}
+
+TEST(fft, convolve)
+{
+    double beta = 10;
+    fmatsubara_grid fgrid(-2,2,beta);
+    kmesh kgrid(4), kgrid2(6);
+    typedef grid_object<complex_type, fmatsubara_grid, kmesh, kmesh> gk_t;
+    gk_t a(std::make_tuple(fgrid, kgrid, kgrid2)), b(a.grids());
+    a.fill([](complex_type w, real_type kx, real_type ky){ return 1.0 / (w - std::cos(kx) - 0.5*std::sin(ky)); });
+    b.fill([](complex_type w, real_type kx, real_type ky){ return w * std::exp(complex_type(0, kx - 2.*ky)) + std::cos(kx + ky); });
+    a.set_tail([](complex_type w, real_type, real_type){ return 1.0 / w; });
+
+    gk_t ph = fft_convolve<1,2>(a, b);
+    gk_t pp = fft_convolve<1,2>(a, b, fft_channel::particle_particle);
+
+    const real_type nk = kgrid.size() * kgrid2.size();
+    for (auto w : fgrid.points()) {
+        for (auto qx : kgrid.points()) {
+            for (auto qy : kgrid2.points()) {
+                complex_type ph0 = 0, pp0 = 0;
+                for (auto kx : kgrid.points()) {
+                    for (auto ky : kgrid2.points()) {
+                        ph0 += a(w, kx, ky) * b[w][(kx.index() + qx.index()) % kgrid.size()][(ky.index() + qy.index()) % kgrid2.size()];
+                        pp0 += a(w, kx, ky) * b[w][(qx.index() + kgrid.size() - kx.index()) % kgrid.size()][(qy.index() + kgrid2.size() - ky.index()) % kgrid2.size()];
+                        }
+                    }
+                EXPECT_NEAR(std::abs(ph(w, qx, qy) - ph0 / nk), 0, 1e-12);
+                EXPECT_NEAR(std::abs(pp(w, qx, qy) - pp0 / nk), 0, 1e-12);
+                }
+            }
+        }    // the tail of a is not carried over to the convolution
+    complex_type w_out = FMatsubara(fgrid.max_n() + 3, beta);
+    EXPECT_EQ(ph(w_out, kgrid[1].value(), kgrid2[2].value()), 0.0);
+    EXPECT_EQ((-0.1 * pp)(w_out, kgrid[1].value(), kgrid2[2].value()), 0.0);
+}
+
+TEST(fft, threads)
+{
+    fft_plan_cache& cache = fft_plan_cache::instance();
+    ASSERT_ANY_THROW(cache.set_threads(0));
+    container<complex_type,3> a(4,4,6);
+    fill_data(a);
+    container<complex_type,3> fa = run_fft(a, FFTW_FORWARD);
+    size_t nplans = cache.size();
+
+    parallel::set_num_threads(8);
+    cache.set_threads(4);
+#ifdef GFTOOLS_FFTW_THREADS
+    EXPECT_EQ(cache.threads(), 4);
+    EXPECT_EQ(cache.plan_threads(), 4);
+    EXPECT_NEAR(run_fft(a, FFTW_FORWARD).diff(fa), 0, 1e-12);
+    // plans for another number of threads are cached separately
+    EXPECT_EQ(cache.size(), nplans + 1);
+    // with a backend the threads are limited by parallel::num_threads
+    parallel::set_num_threads(2);
+    EXPECT_EQ(cache.plan_threads(), parallel::enabled() ? 2 : 4);
+    EXPECT_NEAR(run_fft(a, FFTW_FORWARD).diff(fa), 0, 1e-12);
+    EXPECT_EQ(cache.size(), nplans + 1 + parallel::enabled());
+    // and are 1 in tasks of parallel loops
+    std::vector<int> task_threads(2);
+    parallel::run(task_threads.size(), [&](size_t t){ task_threads[t] = cache.plan_threads(); });
+    for (int n : task_threads) EXPECT_EQ(n, parallel::enabled() ? 1 : 4);
+#else
+    EXPECT_EQ(cache.threads(), 1);
+    EXPECT_NEAR(run_fft(a, FFTW_FORWARD).diff(fa), 0, 1e-12);
+    EXPECT_EQ(cache.size(), nplans);
+#endif
+    cache.set_threads(1);
+    parallel::set_num_threads(0);
+}
+
+TEST(fft, inplace_and_out_of_place)
+{
+    container<complex_type,2> a(6,4);
+    fill_data(a);
+    container<complex_type,2> fa = naive_dft(a, FFTW_FORWARD);
+
+    // in place
+    container<complex_type,2> b(a);
+    const complex_type* b_data = b.data();
+    run_fft_inplace(b, FFTW_FORWARD);
+    EXPECT_EQ(b.data(), b_data);
+    EXPECT_NEAR(b.diff(fa), 0, 1e-12);
+    run_fft_inplace(b, FFTW_BACKWARD);
+    EXPECT_NEAR(b.diff(a), 0, 1e-12);
+
+    // in place on a chunk of external memory
+    std::vector<complex_type> v(a.data(), a.data() + a.size());
+    container_ref<complex_type,2> v_ref(boost::multi_array_ref<complex_type,2>(v.data(), boost::extents[6][4]));
+    run_fft_inplace(v_ref, FFTW_FORWARD);
+    EXPECT_NEAR(std::abs(v[5] - fa.data()[5]), 0, 1e-12);
+
+    // out of place into a given container
+    container<complex_type,2> c(6,4), a0(a);
+    run_fft(a, c, FFTW_FORWARD);
+    EXPECT_NEAR(c.diff(fa), 0, 1e-12);
+    EXPECT_NEAR(a.diff(a0), 0, 0);
+    container<complex_type,2> wrong(4,6);
+    ASSERT_ANY_THROW(run_fft(a, wrong, FFTW_FORWARD));
+}
+
+TEST(fft, real)
+{
+    container<real_type,2> r(6,5);
+    for (int i = 0; i < r.size(); ++i) r.data()[i] = std::cos(0.7*i) + 0.01*i*i;
+    container<complex_type,2> rc(6,5);
+    for (int i = 0; i < r.size(); ++i) rc.data()[i] = r.data()[i];
+    container<complex_type,2> frc = naive_dft(rc, FFTW_FORWARD);
+
+    container<complex_type,2> half = run_fft_r2c(r);
+    EXPECT_EQ(half.shape()[0], 6u);
+    EXPECT_EQ(half.shape()[1], 3u);
+    for (size_t i = 0; i < 6; ++i) for (size_t j = 0; j < 3; ++j) EXPECT_NEAR(std::abs(half[i][j] - frc[i][j]), 0, 1e-12);
+    EXPECT_NEAR(fft_expand_hermitian(half, 5).diff(frc), 0, 1e-12);
+    EXPECT_NEAR(run_fft_c2r(half, 5).diff(r), 0, 1e-12);
+    EXPECT_NEAR((run_fft_c2r<aligned_allocator<real_type,128>>(half, 5).diff(r)), 0, 1e-12);
+    ASSERT_ANY_THROW(run_fft_c2r(half, 7));
+
+    // real dispersion on a kmesh to lattice sites and back
+    kmesh kgrid(4), kgrid2(6);
+    grid_object<real_type, kmesh, kmesh> eps(std::make_tuple(kgrid, kgrid2));
+    eps.fill([](real_type kx, real_type ky){ return -2.*(std::cos(kx) + std::cos(ky)) + 0.3*std::sin(kx)*std::sin(ky); });
+    grid_object<complex_type, kmesh, kmesh> eps_c(eps.grids());
+    eps_c.fill([&](kmesh::point kx, kmesh::point ky){ return complex_type(eps(kx,ky)); });
+    grid_object<complex_type, kmesh, kmesh> eps_r = run_fft_r2c(eps, FFTW_BACKWARD);
+    EXPECT_NEAR(eps_r.grid<1>()[1].value(), 1.0, 1e-14);
+    EXPECT_NEAR(eps_r.diff(run_fft<0,1>(eps_c, FFTW_BACKWARD)), 0, 1e-12);
+    // hopping to nearest neighbours
+    EXPECT_NEAR(std::abs(eps_r(0.,1.) + 1.), 0, 1e-12);
+}
+
+TEST(fft, rank5_axes)
+{
+    container<complex_type,5> chi(2,3,4,2,3);
+    fill_data(chi);
+    // all axes
+    EXPECT_NEAR(run_fft(chi, FFTW_FORWARD).diff(naive_dft(chi, FFTW_FORWARD)), 0, 1e-11);
+    EXPECT_NEAR(run_fft(run_fft(chi, FFTW_FORWARD), FFTW_BACKWARD).diff(chi), 0, 1e-12);
+
+    // only momentum axes of chi(w,w',kx,ky,kz)
+    const std::array<bool,5> mask = {{ false, false, true, true, true }};
+    container<complex_type,5> chi_r = run_fft(chi, FFTW_BACKWARD, mask);
+    for (size_t w1 = 0; w1 < 2; ++w1) {
+        for (size_t w2 = 0; w2 < 3; ++w2) {
+            container<complex_type,3> slice(chi[w1][w2]), slice_r(chi_r[w1][w2]);
+            EXPECT_NEAR(slice_r.diff(run_fft(slice, FFTW_BACKWARD)), 0, 1e-12);
+            }
+        }
+    run_fft_inplace(chi_r, FFTW_FORWARD, mask);
+    EXPECT_NEAR(chi_r.diff(chi), 0, 1e-12);
+}
+
+TEST(fft, small_kernels)
+{
+    fft_plan_cache& cache = fft_plan_cache::instance();
+    cache.set_small_kernels(true);
+    cache.clear();
+    container<complex_type,1> a1(16);
+    container<complex_type,2> a2(8,4);
+    container<complex_type,3> a3(4,16,2);
+    fill_data(a1); fill_data(a2); fill_data(a3);
+    for (int direction : { FFTW_FORWARD, FFTW_BACKWARD }) {
+        container<complex_type,1> f1 = naive_dft(a1, direction);
+        container<complex_type,2> f2 = naive_dft(a2, direction);
+        if (direction == FFTW_BACKWARD) { f1 /= 16.; f2 /= 32.; }
+        EXPECT_NEAR(run_fft(a1, direction).diff(f1), 0, 1e-12);
+        EXPECT_NEAR(run_fft(a2, direction).diff(f2), 0, 1e-12);
+        }
+    container<complex_type,3> f3 = naive_dft(a3, FFTW_FORWARD);
+    EXPECT_NEAR(run_fft(a3, FFTW_FORWARD).diff(f3), 0, 1e-12);
+    // no FFTW plans were made
+    EXPECT_EQ(cache.size(), 0u);
+
+    // batched over a non-small axis of chi(w,kx,ky)
+    container<complex_type,3> chi(5,8,8);
+    fill_data(chi);
+    const std::array<bool,3> mask = {{ false, true, true }};
+    container<complex_type,3> chi_k(chi.shape());
+    run_fft(chi, chi_k, FFTW_FORWARD, mask);
+    EXPECT_EQ(cache.size(), 0u);
+    cache.set_small_kernels(false);
+    EXPECT_NEAR(run_fft(chi, FFTW_FORWARD, mask).diff(chi_k), 0, 1e-12);
+    EXPECT_EQ(cache.size(), 1u);
+    cache.set_small_kernels(true);
+    run_fft_inplace(chi_k, FFTW_BACKWARD, mask);
+    EXPECT_NEAR(chi_k.diff(chi), 0, 1e-12);
+
+    // compile-time kernels
+    container<complex_type,3> b3(a3);
+    run_fft_fixed<4,16,2>(b3, FFTW_FORWARD);
+    EXPECT_NEAR(b3.diff(f3), 0, 1e-12);
+    run_fft_fixed<4,16,2>(b3, FFTW_BACKWARD);
+    EXPECT_NEAR(b3.diff(a3), 0, 1e-12);
+    container<complex_type,2> b2(a2);
+    run_fft_fixed<8,4>(b2, FFTW_BACKWARD);
+    EXPECT_NEAR(b2.diff(run_fft(a2, FFTW_BACKWARD)), 0, 1e-12);
+    ASSERT_ANY_THROW((run_fft_fixed<4,4,2>(b3, FFTW_FORWARD)));
+    cache.set_small_kernels(false);
+    cache.clear();
+}
+
+TEST(fft, wisdom)
+{
+    fft_plan_cache& cache = fft_plan_cache::instance();
+    const std::string fname = "fft_test_wisdom.dat";
+    std::remove(fname.c_str());
+    EXPECT_FALSE(cache.import_wisdom(fname));
+    // no wisdom file yet
+    EXPECT_FALSE(cache.set_wisdom_file(fname));
+    EXPECT_EQ(cache.wisdom_file(), fname);
+
+    // a measured plan is saved to the file
+    container<complex_type,2> a(10,6);
+    fill_data(a);
+    cache.set_rigor(fft_rigor::measure);
+    container<complex_type,2> fa = run_fft(a, FFTW_FORWARD);
+    cache.set_rigor(fft_rigor::estimate);
+    EXPECT_NEAR(fa.diff(naive_dft(a, FFTW_FORWARD)), 0, 1e-12);
+    EXPECT_TRUE(cache.import_wisdom(fname));
+    EXPECT_TRUE(cache.set_wisdom_file(fname));
+
+    EXPECT_TRUE(cache.export_wisdom(fname));
+    cache.set_wisdom_file("");
+    std::remove(fname.c_str());
+    std::remove((fname + ".lock").c_str());
+}
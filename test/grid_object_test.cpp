@@ -7,7 +7,9 @@
 #include "container.hpp"
 #include "grid_object.hpp"
 #include "kmesh.hpp"
+#include "kmesh_patch.hpp"
 #include "enum_grid.hpp"
+#include "real_grid.hpp"
 
 using namespace gftools;
 using namespace tools;
@@ -171,8 +173,303 @@ TEST_F(gridobject_test1, shift)
     EXPECT_DOUBLE_EQ((gf2*gf2+gf*gf).sum(),gf2.size());
 }
 
+TEST(GridObject2, ShiftIndices)
+{
+    double beta = 10;
+    fmatsubara_grid fgrid(-8,8,beta);
+    kmesh kgrid(8);
+    typedef grid_object<complex_type,fmatsubara_grid,kmesh> gk_t;
+    gk_t gk(std::make_tuple(fgrid,kgrid));
+    std::function<complex_type(complex_type,double)> f1 = [](complex_type w, double k){return 1.0/(w - cos(k));};
+    gk.fill(f1);
+    gk.set_tail(f1);
+
+    // integer Matsubara offset and a periodic shift of a kmesh
+    complex_type W = BMatsubara(3,beta);
+    double q = 5.*M_PI/4.;
+    EXPECT_EQ(fgrid.shift_indices(W)[0], 3);
+    EXPECT_EQ(fgrid.shift_indices(W)[13], -1);
+    EXPECT_EQ(kgrid.shift_indices(q)[3], 0);
+    // fermionic + fermionic is not on a fermionic grid
+    EXPECT_EQ(fgrid.shift_indices(FMatsubara(0,beta))[0], -1);
+
+    gk_t gk2 = gk.shift(W,q);
+    for (auto w : fgrid.points()) { 
+        for (auto k : kgrid.points()) { 
+            // points shifted out of the Matsubara grid are taken from the tail
+            EXPECT_NEAR(std::abs(gk2(w,k) - f1(w.value() + W, k.value() + q)), 0, 1e-12);
+        }
+    }
+    EXPECT_NEAR(std::abs(gk2.tail_eval(fgrid[0].value(), 0.) - f1(fgrid[0].value() + W, q)), 0, 1e-12);
+
+    // shift by points is the same as the shift by their values 
+    bmatsubara_grid bgrid(-4,4,beta);
+    gk_t gk3 = gk.shift(std::make_tuple(bgrid.find_nearest(W), kgrid.find_nearest(q)));
+    EXPECT_NEAR(gk3.diff(gk2), 0, 1e-14);
+}
+
+TEST(GridObject2, EvalMany)
+{
+    real_grid rgrid(-5, 5, 41), rgrid2(std::vector<real_type>({ -3., -1., -0.5, 0., 0.2, 1., 2.5, 4. }));
+    std::function<complex_type(real_type)> f1 = [](real_type x){ return 1.0 / complex_type(x, 0.3); };
+    grid_object<complex_type, real_grid> g1(rgrid2);
+    g1.fill(f1);
+    g1.set_tail(f1);
+
+    // sorted, unsorted and out of the grid (tail)
+    std::vector<real_type> xs = { -3., -2.9, -1., -0.7, 0.1, 0.1, 0.9, 3.9, 4., -0.3, -2., 3.5, -4., 7. };
+    std::vector<complex_type> out(xs.size());
+    g1.eval_many(xs.data(), xs.size(), out.data());
+    for (size_t i = 0; i < xs.size(); ++i) EXPECT_EQ(out[i], g1(xs[i]));
+    EXPECT_EQ(out.back(), f1(7.));
+
+    // resample onto another grid
+    grid_object<complex_type, real_grid> g2(rgrid);
+    g1.eval_many(rgrid.values().data(), rgrid.size(), g2.data().data());
+    for (auto x : rgrid.points()) EXPECT_EQ(g2[x.index()], g1(x.value()));
+
+    // slices of a 2d object
+    kmesh kgrid(4);
+    std::function<complex_type(real_type,real_type)> f2 = [](real_type x, real_type k){ return 1.0 / complex_type(x - cos(k), 0.3); };
+    grid_object<complex_type, real_grid, kmesh> g3(std::make_tuple(rgrid2, kgrid));
+    g3.fill(f2);
+    g3.set_tail(f2);
+    std::vector<complex_type> out3(xs.size() * kgrid.size());
+    g3.eval_many(xs.data(), xs.size(), out3.data());
+    for (auto k : kgrid.points()) { 
+        grid_object<complex_type, real_grid> line(rgrid2);
+        line.fill([&](real_type x){ return f2(x, k.value()); });
+        line.set_tail([&](real_type x){ return f2(x, k.value()); });
+        for (size_t i = 0; i < xs.size(); ++i) EXPECT_NEAR(std::abs(out3[i*kgrid.size() + k.index()] - line(xs[i])), 0, 1e-15);
+        }
+
+    // a grid without interpolation
+    double beta = 10;
+    fmatsubara_grid fgrid(-4,4,beta);
+    grid_object<complex_type,fmatsubara_grid,kmesh> gk(std::make_tuple(fgrid,kgrid));
+    gk.fill([](complex_type w, real_type k){ return 1.0/(w - cos(k)); });
+    std::vector<complex_type> ws = { fgrid[3].value(), fgrid[1].value() };
+    std::vector<complex_type> outk(ws.size() * kgrid.size());
+    gk.eval_many(ws.data(), ws.size(), outk.data());
+    EXPECT_EQ(outk[kgrid.size() + 2], gk[1][2]);
+    EXPECT_EQ(outk[1], gk[3][1]);
+}
+
+TEST(GridObject2, Spline)
+{
+    real_grid rgrid(0, 2*M_PI, 13);
+    grid_object<real_type, real_grid> g1(rgrid);
+    g1.fill([](real_type x){ return std::sin(x); });
+    EXPECT_TRUE(g1.get_interpolation() == interpolation::linear);
+    real_type x = 0.9;
+    real_type lin = g1(x);
+
+    g1.set_interpolation(interpolation::cubic_spline);
+    real_type cub = g1(x);
+    EXPECT_LT(std::abs(cub - std::sin(x)), 0.1 * std::abs(lin - std::sin(x)));
+    std::vector<real_type> xs = { 0.1, 0.9, 3.3, 2.0 }, out(xs.size());
+    g1.eval_many(xs.data(), xs.size(), out.data());
+    for (size_t i = 0; i < xs.size(); ++i) EXPECT_EQ(out[i], g1(xs[i]));
+
+    // copies keep the interpolation, modifications rebuild the spline
+    grid_object<real_type, real_grid> g2(g1);
+    EXPECT_TRUE(g2.get_interpolation() == interpolation::cubic_spline);
+    EXPECT_EQ(g2(x), cub);
+    g2[2] += 1.0;
+    EXPECT_NE(g2(x), cub);
+    g2 *= 0.0;
+    EXPECT_EQ(g2(x), 0.0);
+    EXPECT_EQ(g1(x), cub);
+
+    // writes through the non-const accessors rebuild the spline at the next evaluation
+    auto& d = g2.data();
+    for (size_t i = 0; i < rgrid.size(); ++i) d[i] = std::sin(rgrid[i].value());
+    EXPECT_EQ(g2(x), cub);
+    g2.get(std::make_tuple(rgrid[3])) = 100.0;
+    g2(rgrid[4]) = 100.0;
+    grid_object<real_type, real_grid> g3(g2);
+    EXPECT_NE(g2(x), cub);
+    EXPECT_EQ(g2(x), g3(x));
+    real_type out2;
+    g2.eval_many(&x, 1, &out2);
+    EXPECT_EQ(out2, g3(x));
+    // parallel_for_grid modifies the data through the object
+    parallel_for_grid(g2, [](real_type& v, real_grid::point p){ v = std::sin(p.value()); });
+    EXPECT_EQ(g2(x), cub);
+
+    g1.set_interpolation(interpolation::linear);
+    EXPECT_EQ(g1(x), lin);
+}
+
+TEST(GridObject2, Multilinear)
+{
+    real_grid rgrid(std::vector<real_type>({ -3., -1., -0.5, 0., 0.2, 1., 2.5, 4. }));
+    kmesh kgrid(8);
+    // bilinear in x and linear in k between the points of the kmesh : interpolated exactly
+    std::function<real_type(real_type,real_type)> f = [](real_type x, real_type k){ return 2.0 + x - 0.5*k + 0.25*x*k; };
+    grid_object<real_type, real_grid, kmesh> g(std::make_tuple(rgrid, kgrid));
+    g.fill(f);
+    g.set_tail([](real_type, real_type){ return -100.0; });
+    EXPECT_EQ(g(rgrid[3].value(), kgrid[5].value()), g[3][5]);
+    EXPECT_EQ(g(rgrid.values().back(), kgrid[0].value()), g[rgrid.size()-1][0]);
+    EXPECT_NEAR(g(0.7, 1.0), f(0.7, 1.0), 1e-14);
+    EXPECT_NEAR(g(-2.2, 3.3), f(-2.2, 3.3), 1e-14);
+    // out of the real grid : the tail
+    EXPECT_EQ(g(5.0, 1.0), -100.0);
+
+    // periodic along the kmesh : between the last point and 2 PI the values of the last and the first points are mixed
+    real_type k7 = kgrid[7].value(), dk = kgrid[1].value();
+    real_type k = k7 + 0.25*dk;
+    EXPECT_NEAR(g(1.0, k), 0.75*g[5][7] + 0.25*g[5][0], 1e-14);
+    EXPECT_NEAR(g(1.0, k + 2.0*M_PI), g(1.0, k), 1e-12);
+    EXPECT_NEAR(g(1.0, k - 4.0*M_PI), g(1.0, k), 1e-12);
+
+    // batch
+    std::vector<std::tuple<real_type, real_type>> args = { std::make_tuple(0.7, 1.0), std::make_tuple(5.0, 1.0), std::make_tuple(1.0, k) };
+    std::vector<real_type> out(args.size());
+    g.eval_many(args.data(), args.size(), out.data());
+    for (size_t i = 0; i < args.size(); ++i) EXPECT_EQ(out[i], g(args[i]));
+
+    // matsubara frequencies are not interpolated 
+    double beta = 10;
+    fmatsubara_grid fgrid(-4,4,beta);
+    grid_object<complex_type, fmatsubara_grid, kmesh> gk(std::make_tuple(fgrid,kgrid));
+    gk.fill([](complex_type w, real_type k){ return 1.0/(w - cos(k)); });
+    gk.set_tail([](complex_type w, real_type k){ return 1.0/(w - cos(k)); });
+    EXPECT_EQ(gk(fgrid[2].value(), kgrid[3].value()), gk[2][3]);
+    complex_type w0(0, 10.0);
+    EXPECT_EQ(gk(w0, kgrid[3].value()), 1.0/(w0 - cos(kgrid[3].value())));
+    EXPECT_NEAR(std::abs(gk(fgrid[2].value(), k) - (0.75*gk[2][7] + 0.25*gk[2][0])), 0, 1e-14);
+}
+
+TEST(GridObject2, TryEval)
+{
+    // grids report points, that aren't found, without exceptions
+    std::vector<real_type> f = { 1., 2., 4., 8., 16. };
+    real_type out = -1;
+    real_grid rgrid(0, 4, 5, true);
+    EXPECT_TRUE(rgrid.try_eval(f, 2.5, out));
+    EXPECT_EQ(out, rgrid.eval(f, 2.5));
+    out = -1;
+    EXPECT_FALSE(rgrid.try_eval(f, 4.5, out));
+    EXPECT_FALSE(rgrid.try_eval(f, std::nan(""), out));
+    EXPECT_EQ(out, -1);
+    EXPECT_THROW(rgrid.eval(f, 4.5), real_grid::ex_not_found);
+
+    enum_grid egrid(2, 7);
+    EXPECT_TRUE(egrid.try_eval(f, 3, out));
+    EXPECT_EQ(out, 2.);
+    EXPECT_FALSE(egrid.try_eval(f, 7, out));
+
+    fmatsubara_grid fgrid(-2, 3, 10.);
+    std::vector<complex_type> fw(fgrid.size(), 1.0);
+    complex_type outw;
+    EXPECT_TRUE(fgrid.try_eval(fw, fgrid[1].value(), outw));
+    EXPECT_FALSE(fgrid.try_eval(fw, complex_type(0, 0.5), outw));
+
+    kmesh kgrid(8);
+    kmesh_patch patch(kgrid, { 1, 4 });
+    EXPECT_TRUE(patch.try_eval(f, kgrid[4].value(), out));
+    EXPECT_EQ(out, f[1]);
+    EXPECT_EQ(patch.eval(f, kgrid[4].value()), f[1]);
+    EXPECT_FALSE(patch.try_eval(f, kgrid[2].value(), out));
+
+    // grid_object : the tail is used for the points outside of the grid
+    std::function<real_type(real_type)> f1 = [](real_type x){ return 1.0 / (1.0 + x*x); };
+    grid_object<real_type, real_grid> g1(rgrid);
+    g1.fill(f1);
+    g1.set_tail(f1);
+    EXPECT_EQ(g1(-3.), f1(-3.));
+    EXPECT_EQ(g1(3.), g1[3]);
+    g1.set_interpolation(interpolation::cubic_spline);
+    EXPECT_EQ(g1(10.), f1(10.));
+    std::vector<real_type> xs = { 1.5, 10., -1., 2.2 }, out1(xs.size());
+    g1.eval_many(xs.data(), xs.size(), out1.data());
+    for (size_t i = 0; i < xs.size(); ++i) EXPECT_EQ(out1[i], g1(xs[i]));
+}
+
+TEST(GridObject2, FillLoops)
+{
+    enum_grid egrid(0, 3);
+    real_grid rgrid(-1., 1., 5, true);
+    kmesh kgrid(4);
+    grid_object<complex_type, enum_grid, real_grid, kmesh> g1(std::make_tuple(egrid, rgrid, kgrid)), g2(g1.grids()), g3(g1.grids());
+    auto f = [](int n, real_type x, real_type k){ return complex_type(n + x, cos(k)); };
+    g1.fill(f);
+    std::function<complex_type(int, real_type, real_type)> f_std = f;
+    g2.fill_function(f_std);
+    g3.fill([&](enum_grid::point n, real_grid::point x, kmesh::point k){ return f(n.value(), x.value(), k.index()); });
+    for (auto n : egrid.points()) for (auto x : rgrid.points()) for (auto k : kgrid.points()) { 
+        EXPECT_EQ(g1[n.index()][x.index()][k.index()], f(n.value(), x.value(), k.value()));
+        EXPECT_EQ(g3[n.index()][x.index()][k.index()], f(n.value(), x.value(), real_type(k.index())));
+        }
+    EXPECT_EQ(g1.diff(g2), 0.0);
+    // the tail is set to the function of values
+    EXPECT_EQ(g1.tail_eval(5, 0.3, 1.0), f(5, 0.3, 1.0));
+}
+
 
+TEST(GridObject2, Allocator)
+{
+    kmesh k(8);
+    fmatsubara_grid w(-4, 4, 10.0);
+    typedef grid_object_alloc<complex_type, aligned_allocator<complex_type, 128>, fmatsubara_grid, kmesh> gw_type;
+    gw_type g(std::make_tuple(w, k));
+    EXPECT_EQ(reinterpret_cast<std::uintptr_t>(g.data().data()) % 128, 0u);
+    auto f = [](complex_type x, real_type q){ return 1.0 / (x - cos(q)); };
+    g.fill(f);
+    grid_object<complex_type, fmatsubara_grid, kmesh> g2(g.grids());
+    g2.fill(f);
+    EXPECT_EQ(g.diff(g2), 0.0);
+    EXPECT_EQ(g.shift(std::make_tuple(w[1], k[2])).diff(g2.shift(std::make_tuple(w[1], k[2]))), 0.0);
+}
 
+TEST(GridObject2, SharedGrids)
+{
+    fmatsubara_grid w(-4, 4, 10.0);
+    real_grid r = real_grid::logarithmic(0.01, 10.0, 100);
+    kmesh k(8);
+    typedef grid_object<complex_type, fmatsubara_grid, real_grid, kmesh> g_type;
+    g_type g(std::make_tuple(w, r, k));
+    g.fill([](complex_type x, real_type e, real_type q){ return 1.0 / (x - e*cos(q)); });
+    auto same_points = [](g_type const& a, g_type const& b){ 
+        return a.grid<0>().values().data() == b.grid<0>().values().data() && a.grid<1>().values().data() == b.grid<1>().values().data()
+            && a.grid<2>().values().data() == b.grid<2>().values().data(); };
+    // copies, results of arithmetics and shifts share the points of the grids
+    g_type g2(g);
+    EXPECT_TRUE(same_points(g, g2));
+    EXPECT_TRUE(same_points(g, g_type(g * 2.0 + g2)));
+    EXPECT_TRUE(same_points(g, g.shift(std::make_tuple(w[1], r[0], k[3]))));
+    EXPECT_EQ(g.grid<1>().values().data(), r.values().data());
+    EXPECT_EQ(g.diff(g2), 0.0);
+
+    // equal grids, made separately, are equal by the fingerprint of their points
+    g_type g3(std::make_tuple(fmatsubara_grid(-4, 4, 10.0), real_grid::logarithmic(0.01, 10.0, 100), kmesh(8)));
+    EXPECT_FALSE(same_points(g, g3));
+    g3 = g;
+    EXPECT_EQ(g.diff(g3), 0.0);
+    EXPECT_TRUE(g3.grid<1>() == g.grid<1>());
+    // almost equal grids are still equal
+    std::vector<real_type> rv(r.values());
+    rv[5] += 1e-14;
+    g_type g4(std::make_tuple(w, real_grid(rv), k));
+    g4 = g;
+    EXPECT_EQ(g.diff(g4), 0.0);
+    g_type g5(std::make_tuple(w, real_grid(0.01, 10.0, 100), k));
+    g5 = g;
+    EXPECT_THROW(g.diff(g5), ex_generic);
+
+    // writes to a shared copy of the values don't change the other copies
+    shared_values<real_type> v1(r.values()), v2(v1);
+    EXPECT_TRUE(v1.shares(v2));
+    auto h = v1.fingerprint();
+    EXPECT_EQ(h, v2.fingerprint());
+    v2[0] = 1.0;
+    EXPECT_FALSE(v1.shares(v2));
+    EXPECT_EQ(v1[0], r.values()[0]);
+    EXPECT_EQ(v1.fingerprint(), h);
+    EXPECT_NE(v2.fingerprint(), h);
+}
 
 int main(int argc, char **argv) 
 {
@@ -46,6 +46,17 @@ int main()
     std::cout << "grid size = " << g2.size() << std::endl;
     if (g2.size() != 3) return EXIT_FAILURE;
 
+    // points are made from the stored values, values are not copied
+    auto pts = g2.points();
+    if (pts.size() != 3 || std::distance(pts.begin(), pts.end()) != 3) return EXIT_FAILURE;
+    size_t i = 0;
+    for (auto p : pts) { if (p.index() != i || p.value().x != g2.values()[i].x) return EXIT_FAILURE; ++i; }
+    // values() returns the stored values, not a copy of them
+    if (&g2.values()[0] != &g2.values()[0] || &g2.values() != &g2.values()) return EXIT_FAILURE;
+    if (pts.back().index() != 2 || (*(pts.begin() + 2)).value().x != g2.values()[2].x) return EXIT_FAILURE;
+    // beyond the last point
+    if (g2.find_nearest(my_data(10)) != g2[2]) return EXIT_FAILURE;
+
     std::vector<int> data_y ( { 1, 4, 5} );
     bool success =  (g2.eval(data_y, g2[1]) == data_y[1]);
     std::cout << "y[" << g2[1] << "]=" << g2.eval(data_y, g2[1]) << std::endl;
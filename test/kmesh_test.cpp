@@ -25,6 +25,16 @@ int main()
     std::cout << "y[" << k1[2] << "]=" << patch1.eval(data_y,k1[2]) << std::endl;
     if (patch1.eval(data_y,k1[2]) != 1) return EXIT_FAILURE;
 
+    // points of the patch itself carry the indices in the patch
+    kmesh k2(8);
+    kmesh_patch patch2(k2, {1, 4});
+    std::vector<int> data_p = {10, 20};
+    std::vector<size_t> parent_idx = {1, 4};
+    for (auto p : patch2.points()) { 
+        if (patch2.eval(data_p, p) != data_p[p.index()] || patch2.get_index(p) != p.index()) return EXIT_FAILURE;
+        if (patch2.eval(data_p, k2[parent_idx[p.index()]]) != data_p[p.index()]) return EXIT_FAILURE;
+        }
+
 
     DEBUG(k1.eval(data_y, k1[2]));
 
@@ -9,12 +9,74 @@
 
 using namespace gftools;
 
-TEST(math_expr, t1)
+TEST(math_expr, lazy)
 {
+    container<double,2> a(3,4), b(3,4);
+    std::iota(a.data(), a.data() + a.size(), 1.0);
+    b = 2.0;
+
+    auto e = a * b + 1.0;
+    static_assert(std::is_same<decltype(e)::value_type, double>::value, "wrong value_type");
+    EXPECT_EQ(e.shape(), a.shape());
+    EXPECT_EQ(e.size(), size_t(a.size()));
+
+    // nothing is evaluated until assignment
+    a[0][0] = 10.0;
+    container<double,2> c = e;
+    EXPECT_DOUBLE_EQ(c[0][0], 21.0);
+    EXPECT_DOUBLE_EQ(c[2][3], 25.0);
+    EXPECT_DOUBLE_EQ(e.sum(), c.sum());
+    EXPECT_DOUBLE_EQ(e.eval().diff(c), 0.0);
+}
+
+TEST(math_expr, scalars)
+{
+    container<complex_type,1> a(5);
+    a = 2.0 + 1.0*I;
+    double T = 0.5;
+
+    container<complex_type,1> c = -T * a * a / 2.0 - 1.0;
+    complex_type v = -T * (2.0 + 1.0*I) * (2.0 + 1.0*I) / 2.0 - 1.0;
+    for (size_t i=0; i<5; i++) EXPECT_NEAR(std::abs(c[i] - v), 0.0, 1e-14);
+
+    c = 1.0 / a + 3.0 - a;
+    v = 1.0 / (2.0 + 1.0*I) + 3.0 - (2.0 + 1.0*I);
+    for (size_t i=0; i<5; i++) EXPECT_NEAR(std::abs(c[i] - v), 0.0, 1e-14);
+}
+
+TEST(math_expr, views)
+{
+    container<double,3> a(2,3,4);
+    container<double,2> b(3,4);
+    std::iota(a.data(), a.data() + a.size(), 0.0);
+    b = 1.0;
+
+    container<double,2> c = a[1] - b;
+    EXPECT_DOUBLE_EQ(c[0][0], 11.0);
+    // compound assignments accept expressions and evaluate them in place
+    b += a[0] * 2.0;
+    EXPECT_DOUBLE_EQ(b[2][3], 23.0);
+    a[0] = a[1] * b;
+    EXPECT_DOUBLE_EQ(a[0][2][3], 23.0 * 23.0);
+}
+
+TEST(math_expr, grid_object)
+{
+    typedef grid_object<double, real_grid, real_grid> gf_t;
+    real_grid grid(0, 1., 10);
+    gf_t f(grid, grid), g(grid, grid);
+    f.fill([](double x, double y){return sin(x+y);});
+    g.fill([](double x, double y){return cos(x+y);});
+
+    gf_t h(f.grids(), f.data() * f.data() + g.data() * g.data());
+    EXPECT_NEAR(h.sum(), double(h.size()), 1e-12);
+    gf_t h2 = f*f + g*g;
+    EXPECT_NEAR(h2.diff(h), 0.0, 1e-14);
+    gf_t h3 = -2.0 * h2 / 2.0 + 1.0;
+    EXPECT_NEAR(std::abs(h3.sum()), 0.0, 1e-12);
 }
 
 int main(int argc, char **argv) {
-    std::cout << "Hi!" << std::endl;
     ::testing::InitGoogleTest(&argc, argv);
     return RUN_ALL_TESTS();
 }
@@ -0,0 +1,260 @@
+#include <chrono>
+#include <fstream>
+#include <numeric>
+#include <random>
+#include <sstream>
+#include <stdexcept>
+#include <thread>
+
+#include "gtest/gtest.h"
+
+#include "defaults.hpp"
+#include "parallel.hpp"
+#include "container.hpp"
+#include "grid_object.hpp"
+#include "matsubara_grid.hpp"
+#include "kmesh.hpp"
+#include "fft_kernels.hpp"
+
+using namespace gftools;
+
+/// a number, whose additions count, how many of them ran in tasks of parallel loops
+struct task_counted {
+    double v;
+    task_counted(double x = 0):v(x){}
+    task_counted operator+(task_counted const& r) const { if (parallel::in_task()) in_tasks()++; return task_counted(v + r.v); }
+    task_counted& operator+=(task_counted const& r) { return *this = *this + r; }
+    static std::atomic<int>& in_tasks() { static std::atomic<int> n(0); return n; }
+};
+
+namespace Eigen {
+template <> struct NumTraits<task_counted> : GenericNumTraits<task_counted> {
+    typedef task_counted Real;
+    typedef task_counted NonInteger;
+    typedef task_counted Nested;
+    enum { IsComplex = 0, IsInteger = 0, IsSigned = 1, RequireInitialization = 1, ReadCost = 1, AddCost = 1, MulCost = 1 };
+};
+} // end of namespace Eigen
+
+/// runs the parallel loops with 4 threads for any size
+struct parallel_test : public ::testing::Test {
+protected:
+    virtual void SetUp() { threshold_ = parallel::threshold(); parallel::set_threshold(1); parallel::set_num_threads(4); }
+    virtual void TearDown() { parallel::set_threshold(threshold_); parallel::set_num_threads(0); }
+    size_t threshold_;
+};
+
+TEST_F(parallel_test, Run)
+{
+    EXPECT_TRUE(parallel::enabled());
+    std::vector<std::atomic<int>> count(1000);
+    for (auto& c : count) c = 0;
+    parallel::run(count.size(), [&](size_t t){ count[t]++; });
+    for (auto& c : count) EXPECT_EQ(c, 1);
+
+    // nested loops are shared by the same threads
+    std::atomic<int> total(0);
+    parallel::run(8, [&](size_t){ EXPECT_TRUE(parallel::in_task()); parallel::run(10, [&](size_t){ total++; }); });
+    EXPECT_EQ(total, 80);
+    EXPECT_FALSE(parallel::in_task());
+    EXPECT_THROW(parallel::run(4, [](size_t t){ parallel::run(10, [t](size_t s){ if (t == 2 && s == 7) throw std::runtime_error("nested"); }); }), 
+                 std::runtime_error);
+
+    EXPECT_THROW(parallel::run(100, [](size_t t){ if (t == 42) throw std::runtime_error("task"); }), std::runtime_error);
+    // the pool works after an exception
+    total = 0;
+    parallel::run(100, [&](size_t){ total++; });
+    EXPECT_EQ(total, 100);
+}
+
+TEST_F(parallel_test, Scheduler)
+{
+    // unbalanced tasks : idle threads steal the rest of the tasks
+    std::vector<std::atomic<int>> count(256);
+    for (auto& c : count) c = 0;
+    parallel::run(count.size(), [&](size_t t){ 
+        if (t % 64 == 0) std::this_thread::sleep_for(std::chrono::milliseconds(2));
+        count[t]++; 
+        });
+    for (auto& c : count) EXPECT_EQ(c, 1);
+
+    // three levels of nested loops and concurrent callers
+    std::atomic<int> total(0);
+    std::vector<std::thread> callers;
+    for (int c = 0; c < 3; ++c) callers.emplace_back([&](){ 
+        parallel::run(4, [&](size_t){ parallel::run(5, [&](size_t){ parallel::run(6, [&](size_t){ total++; }); }); });
+        });
+    for (auto& c : callers) c.join();
+    EXPECT_EQ(total, 3*4*5*6);
+
+    std::vector<size_t> ranges(1000, 0);
+    parallel::for_each_range(ranges.size(), ranges.size(), [&](size_t b, size_t e){ for (size_t i = b; i < e; ++i) ranges[i] += i; });
+    for (size_t i = 0; i < ranges.size(); ++i) EXPECT_EQ(ranges[i], i);
+}
+
+TEST_F(parallel_test, Chunks)
+{
+    std::vector<double> v(10007);
+    for (size_t offset : { 0, 1, 3 }) {
+        const double* data = v.data() + offset;
+        size_t n = v.size() - offset;
+        std::vector<std::atomic<int>> count(n);
+        for (auto& c : count) c = 0;
+        parallel::for_each_chunk(data, n, [&](size_t b, size_t e){
+            for (size_t i = b; i < e; ++i) count[i]++;
+            if (b != 0) { EXPECT_EQ(reinterpret_cast<std::uintptr_t>(data + b) % parallel::cache_line, 0u); }
+            });
+        for (auto& c : count) EXPECT_EQ(c, 1);
+        }
+}
+
+TEST_F(parallel_test, Reduce)
+{
+    const size_t n = 100003;
+    std::mt19937 gen(1);
+    std::uniform_real_distribution<double> dist(-1.0, 1.0);
+    std::vector<double> v(n);
+    for (auto& x : v) x = dist(gen) * std::pow(10.0, 8*dist(gen));
+    auto partial = [&](size_t b, size_t e){ return std::accumulate(v.begin() + b, v.begin() + e, 0.0); };
+    auto plus = [](double x, double y){ return x + y; };
+
+    // pairwise combination of the chunks in a fixed order
+    std::vector<double> parts;
+    for (size_t b = 0; b < n; b += parallel::reduce_chunk) parts.push_back(partial(b, std::min(n, b + parallel::reduce_chunk)));
+    for (size_t w = 1; w < parts.size(); w *= 2) for (size_t i = 0; i + w < parts.size(); i += 2*w) parts[i] += parts[i+w];
+
+    for (int nthreads : { 1, 2, 3, 4, 7 }) {
+        parallel::set_num_threads(nthreads);
+        EXPECT_EQ(parallel::reduce<double>(n, partial, plus), parts[0]);
+        // the same in nested loops
+        std::vector<double> nested(3);
+        parallel::run(nested.size(), [&](size_t t){ nested[t] = parallel::reduce<double>(n, partial, plus); });
+        for (double r : nested) EXPECT_EQ(r, parts[0]);
+        }
+    // nor on the threshold of parallel loops
+    parallel::set_threshold(2*n);
+    EXPECT_EQ(parallel::reduce<double>(n, partial, plus), parts[0]);
+    parallel::set_threshold(1);
+    // sums of containers don't depend on the number of threads either
+    container<double,1> c(n);
+    std::copy(v.begin(), v.end(), c.data());
+    const double sum1 = c.sum();
+    parallel::set_num_threads(3);
+    EXPECT_EQ(c.sum(), sum1);
+    double nested_sum = 0;
+    parallel::run(2, [&](size_t t){ if (t == 0) nested_sum = c.sum(); });
+    EXPECT_EQ(nested_sum, sum1);
+
+    // sums of containers below the threshold run in the calling thread
+    container<task_counted,1> t(n);
+    for (size_t i = 0; i < n; ++i) t.data()[i] = v[i];
+    const double tsum1 = t.sum().v;
+    EXPECT_GT(task_counted::in_tasks().load(), 0);
+    task_counted::in_tasks() = 0;
+    parallel::set_threshold(n + 1);
+    EXPECT_EQ(t.sum().v, tsum1);
+    EXPECT_EQ(task_counted::in_tasks().load(), 0);
+    parallel::set_threshold(1);
+}
+
+TEST_F(parallel_test, Container)
+{
+    const size_t n0 = 37, n1 = 1001;
+    container<complex_type,2> a(n0, n1), b(n0, n1);
+    for (size_t i = 0; i < n0; ++i) for (size_t j = 0; j < n1; ++j) { a[i][j] = complex_type(i, j); b[i][j] = complex_type(1.0 + j, i*0.5); }
+    container<complex_type,2> a2(a);
+    a2 += b;
+    a2 *= 2.0;
+    a2 /= b;
+    a2 -= a*b + 1.0;
+    container<complex_type,2> c(a*2.0 - b);
+    parallel::set_num_threads(1);
+    container<complex_type,2> s2(a);
+    s2 += b;
+    s2 *= 2.0;
+    s2 /= b;
+    s2 -= a*b + 1.0;
+    EXPECT_EQ(a2.diff(s2), 0.0);
+    EXPECT_EQ(c.diff(container<complex_type,2>(a*2.0 - b)), 0.0);
+
+    // sums are the same for any number of threads
+    parallel::set_num_threads(2);
+    complex_type sum2 = a2.sum();
+    double diff2 = a2.diff(b);
+    parallel::set_num_threads(5);
+    EXPECT_EQ(a2.sum(), sum2);
+    EXPECT_EQ(a2.diff(b), diff2);
+    EXPECT_NEAR(std::abs(sum2 - s2.sum()), 0.0, 1e-8 * std::abs(sum2));
+}
+
+TEST_F(parallel_test, GridObjectFill)
+{
+    fmatsubara_grid fgrid(-8, 8, 10.0);
+    kmesh kgrid(12);
+    typedef grid_object<complex_type, fmatsubara_grid, kmesh, kmesh> gk_type;
+    gk_type g1(std::make_tuple(fgrid, kgrid, kgrid)), g2(g1.grids());
+    auto f = [](complex_type w, real_type kx, real_type ky){ return 1.0 / (w + 2.0*(cos(kx) + cos(ky))); };
+    g1.fill(f);
+    parallel::set_num_threads(1);
+    g2.fill(f);
+    EXPECT_EQ(g1.diff(g2), 0.0);
+    parallel::set_num_threads(3);
+    std::function<complex_type(fmatsubara_grid::point, kmesh::point, kmesh::point)> fp =
+        [&](fmatsubara_grid::point w, kmesh::point kx, kmesh::point ky){ return f(w.value(), kx.value(), ky.value()); };
+    g1 = 0.0;
+    g1.fill(fp);
+    EXPECT_EQ(g1.diff(g2), 0.0);
+}
+
+TEST_F(parallel_test, ParallelForGrid)
+{
+    fmatsubara_grid fgrid(-8, 8, 10.0);
+    kmesh kgrid(12);
+    typedef grid_object<complex_type, fmatsubara_grid, kmesh, kmesh> gk_type;
+    gk_type g1(std::make_tuple(fgrid, kgrid, kgrid)), g2(g1.grids());
+    auto f = [](complex_type w, real_type kx, real_type ky){ return 1.0 / (w + 2.0*(cos(kx) + cos(ky))); };
+    g2.fill(f);
+    parallel_for_grid(g1, [&](complex_type& v, fmatsubara_grid::point w, kmesh::point kx, kmesh::point ky){ v = f(w.value(), kx.value(), ky.value()); });
+    EXPECT_EQ(g1.diff(g2), 0.0);
+
+    std::atomic<int> count(0);
+    gk_type const& g3 = g1;
+    auto const& d2 = g2.data();
+    parallel_for_grid(g3, [&](complex_type const& v, fmatsubara_grid::point w, kmesh::point kx, kmesh::point ky){ 
+        if (v == d2[w.index()][kx.index()][ky.index()]) count++; });
+    EXPECT_EQ(size_t(count.load()), g1.size());
+}
+
+TEST_F(parallel_test, ShiftSave)
+{
+    fmatsubara_grid fgrid(-8, 8, 10.0);
+    kmesh kgrid(24);
+    typedef grid_object<complex_type, fmatsubara_grid, kmesh, kmesh> gk_type;
+    gk_type g(std::make_tuple(fgrid, kgrid, kgrid));
+    g.fill([](complex_type w, real_type kx, real_type ky){ return 1.0 / (w + 2.0*(cos(kx) + cos(ky))); });
+    auto shift = std::make_tuple(fgrid[3], kgrid[5], kgrid[2]);
+
+    gk_type s1 = g.shift(shift);
+    g.savetxt("parallel_test_1.dat");
+    parallel::set_num_threads(1);
+    gk_type s2 = g.shift(shift);
+    g.savetxt("parallel_test_2.dat");
+    EXPECT_EQ(s1.diff(s2), 0.0);
+
+    std::ifstream f1("parallel_test_1.dat"), f2("parallel_test_2.dat");
+    std::stringstream t1, t2;
+    t1 << f1.rdbuf(); t2 << f2.rdbuf();
+    EXPECT_FALSE(t1.str().empty());
+    EXPECT_EQ(t1.str(), t2.str());
+}
+
+TEST_F(parallel_test, FFTKernels)
+{
+    container<complex_type,3> a(8, 8, 8);
+    for (int i = 0; i < a.size(); ++i) a.data()[i] = complex_type(std::sin(0.1*i), std::cos(0.3*i));
+    container<complex_type,3> b(a);
+    run_fft_fixed<8,8,8>(a, -1);
+    parallel::set_num_threads(1);
+    run_fft_fixed<8,8,8>(b, -1);
+    EXPECT_EQ(a.diff(b), 0.0);
+}
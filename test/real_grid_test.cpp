@@ -2,6 +2,30 @@
 #include "real_grid.hpp"
 
 using namespace gftools;
+
+/// compare real_grid::find with a linear search on npts points in the grid
+bool check_find(real_grid const& grid, int npts)
+{
+    auto const& v = grid.values();
+    int n = v.size();
+    for (int p = 0; p <= npts; ++p) {
+        real_type x = (p == npts) ? v[n-1] : grid.min() + (grid.max() - grid.min()) * p / npts;
+        int i = 0;
+        while (i < n-2 && v[i+1] < x) ++i;
+        auto f = grid.find(x);
+        if (!std::get<0>(f) || int(std::get<1>(f)) != i || !almost_equal(std::get<2>(f), (x - v[i]) / (v[i+1] - v[i]), 1e-14)) { 
+            ERROR("find(" << x << ") = " << std::get<1>(f) << ", expected " << i);
+            return false;
+            }
+        }
+    // all grid points
+    for (int i = 1; i < n; ++i) { 
+        auto f = grid.find(v[i]);
+        if (int(std::get<1>(f)) != i-1 || std::get<2>(f) != 1.0) return false;
+        }
+    return std::get<2>(grid.find(v[0])) == 0.0;
+}
+
 int main()
 {
     real_grid grid1(-5,5,20);
@@ -28,6 +52,59 @@ int main()
 
     auto p1 = grid3.find_nearest(2.);
     std::cout << "2 = " << p1 << std::endl;
+
+    // O(1) lookups
+    real_grid log_grid = real_grid::logarithmic(1e-3, 10., 41);
+    real_grid tan_grid = real_grid::tangent(20., 101);
+    real_grid cheb_grid = real_grid::chebyshev(-2., 3., 30);
+    std::cout << "log grid : " << log_grid << std::endl;
+    if (grid1.map().kind_ != real_grid::index_map::kind::uniform || grid3.map().kind_ != real_grid::index_map::kind::uniform) return EXIT_FAILURE;
+    if (grid2.map().kind_ != real_grid::index_map::kind::none) return EXIT_FAILURE;
+    if (log_grid.min() != 1e-3 || log_grid.max() != 10. || tan_grid.min() != -20.) return EXIT_FAILURE;
+    for (real_grid const* g : { &grid1, &grid2, &grid3, &log_grid, &tan_grid, &cheb_grid }) 
+        if (!check_find(*g, 997)) return EXIT_FAILURE;
+
+    // search buckets for a large non-uniform grid
+    std::vector<real_type> v4;
+    for (int i = -1000; i < 1000; ++i) v4.push_back(std::pow(i*1e-3, 3) + 1e-4*std::sin(i));
+    real_grid grid4(v4);
+    if (grid4.is_uniform() || !grid4.has_search_buckets() || grid2.has_search_buckets()) return EXIT_FAILURE;
+    if (!check_find(grid4, 20011)) return EXIT_FAILURE;
+
+    // linear interpolation at the first point
+    std::vector<real_type> y(grid1.size());
+    for (size_t i = 0; i < y.size(); ++i) y[i] = i*i;
+    if (grid1.eval(y, grid1.min()) != 0.0 || grid1.eval(y, grid1.values()[3]) != 9.0) return EXIT_FAILURE;
+
+    // cubic splines on a coarse grid
+    real_grid coarse(0, 2*M_PI, 13);
+    std::vector<real_type> ys(coarse.size());
+    for (size_t i = 0; i < ys.size(); ++i) ys[i] = std::sin(coarse.values()[i]);
+    auto s1 = coarse.spline<real_type>(ys, interpolation::cubic_spline);
+    real_type err_lin = 0, err_spline = 0;
+    for (real_type x = 0.01; x < 2*M_PI; x += 0.05) { 
+        err_lin = std::max(err_lin, std::abs(coarse.eval(ys, x) - std::sin(x)));
+        err_spline = std::max(err_spline, std::abs(coarse.eval(ys, s1, x) - std::sin(x)));
+        }
+    std::cout << "sin(x) on 13 points, max error : linear " << err_lin << ", cubic spline " << err_spline << std::endl;
+    if (err_spline > 0.1 * err_lin) return EXIT_FAILURE;
+    if (!almost_equal(coarse.eval(ys, s1, coarse.values()[5]), ys[5], 1e-14)) return EXIT_FAILURE;
+    std::vector<real_type> xs2 = { 0.3, 1.7, 1.71, 6.2, 0.1 }, out2(xs2.size());
+    coarse.eval_many(ys, s1, xs2.data(), xs2.size(), out2.data());
+    for (size_t i = 0; i < xs2.size(); ++i) if (out2[i] != coarse.eval(ys, s1, xs2[i])) return EXIT_FAILURE;
+
+    // monotone spline doesn't overshoot a step
+    std::vector<real_type> step(coarse.size());
+    for (size_t i = 0; i < step.size(); ++i) step[i] = (i < 6) ? 0.0 : 1.0;
+    auto s2 = coarse.spline<real_type>(step, interpolation::monotone_cubic);
+    auto s3 = coarse.spline<real_type>(step, interpolation::cubic_spline);
+    real_type lo = 0, hi = 1, lo3 = 0;
+    for (real_type x = 0.0; x < 2*M_PI; x += 0.01) { 
+        lo = std::min(lo, coarse.eval(step, s2, x)); hi = std::max(hi, coarse.eval(step, s2, x)); 
+        lo3 = std::min(lo3, coarse.eval(step, s3, x));
+        }
+    std::cout << "step : monotone spline in [" << lo << ", " << hi << "], natural spline min " << lo3 << std::endl;
+    if (lo < 0.0 || hi > 1.0 || lo3 >= 0.0) return EXIT_FAILURE;
     
     return EXIT_SUCCESS;
 }